@@ -0,0 +1,167 @@
+#include <cstdio>
+#include <vector>
+
+#ifndef BUDDY_ALLOCATOR
+#define BUDDY_ALLOCATOR
+
+/* Binary buddy allocator over frame numbers 0..num_frames-1.
+   A free block of order k covers 2^k frames starting at a multiple of 2^k.
+   Each order has an intrusive doubly linked free list threaded through the
+   block's first frame, so allocation, freeing and buddy coalescing are
+   O(max order). Frame counts that aren't a power of two are covered by the
+   largest aligned blocks that fit. */
+class BuddyAllocator
+{
+public:
+    BuddyAllocator(unsigned int num_frames_)
+    {
+        num_frames = num_frames_;
+        max_order = 0;
+        while ((2u << max_order) <= num_frames)
+        {
+            max_order++;
+        }
+        heads.assign(max_order + 1, NIL);
+        counts.assign(max_order + 1, 0);
+        failed.assign(max_order + 1, 0);
+        prev.assign(num_frames, NIL);
+        next.assign(num_frames, NIL);
+        free_order.assign(num_frames, NOT_FREE);
+
+        // Carve the frame range into maximal aligned blocks
+        unsigned int frame = 0;
+        while (frame < num_frames)
+        {
+            unsigned int order = max_order;
+            while ((frame & ((1u << order) - 1)) || frame + (1u << order) > num_frames)
+            {
+                order--;
+            }
+            push(frame, order);
+            frame += 1u << order;
+        }
+    }
+
+    unsigned int get_max_order() const
+    {
+        return max_order;
+    }
+
+    // First frame of a free, aligned block of 2^order frames, -1 if none is left
+    int allocate(unsigned int order)
+    {
+        if (order > max_order)
+        {
+            return -1;
+        }
+        unsigned int from = order;
+        while (from <= max_order && heads[from] == NIL)
+        {
+            from++;
+        }
+        if (from > max_order)
+        {
+            failed[order]++;
+            return -1;
+        }
+
+        // Split the smallest fitting block, handing the upper halves back
+        int block = heads[from];
+        pop(block, from);
+        while (from > order)
+        {
+            from--;
+            push(block + (1 << from), from);
+        }
+        return block;
+    }
+
+    // Returns a block, merging it with its buddy as long as that one is free too
+    void free(unsigned int frame, unsigned int order)
+    {
+        while (order < max_order)
+        {
+            unsigned int buddy = frame ^ (1u << order);
+            if (buddy >= num_frames || free_order[buddy] != (int)order)
+            {
+                break;
+            }
+            pop(buddy, order);
+            frame &= ~(1u << order);
+            order++;
+        }
+        push(frame, order);
+    }
+
+    unsigned long free_blocks(unsigned int order) const
+    {
+        return counts[order];
+    }
+
+    unsigned long failed_allocations(unsigned int order) const
+    {
+        return failed[order];
+    }
+
+    // Fragmentation report: free blocks per order, then failed high order allocations
+    void print_stats(FILE *out = stdout) const
+    {
+        fprintf(out, "BUDDY:");
+        for (unsigned int order = 0; order <= max_order; order++)
+        {
+            fprintf(out, " %u:%lu", order, counts[order]);
+        }
+        unsigned long failed_high = 0;
+        for (unsigned int order = 1; order <= max_order; order++)
+        {
+            failed_high += failed[order];
+        }
+        fprintf(out, " failed=%lu\n", failed_high);
+    }
+
+private:
+    const int NIL = -1;
+    const int NOT_FREE = -1;
+    unsigned int num_frames;
+    unsigned int max_order;
+    std::vector<int> heads;
+    std::vector<unsigned long> counts;
+    std::vector<unsigned long> failed;
+    std::vector<int> prev;
+    std::vector<int> next;
+    // Order of the free block starting at a frame, NOT_FREE otherwise
+    std::vector<int> free_order;
+
+    void push(int block, unsigned int order)
+    {
+        prev[block] = NIL;
+        next[block] = heads[order];
+        if (heads[order] != NIL)
+        {
+            prev[heads[order]] = block;
+        }
+        heads[order] = block;
+        free_order[block] = order;
+        counts[order]++;
+    }
+
+    void pop(int block, unsigned int order)
+    {
+        if (prev[block] != NIL)
+        {
+            next[prev[block]] = next[block];
+        }
+        else
+        {
+            heads[order] = next[block];
+        }
+        if (next[block] != NIL)
+        {
+            prev[next[block]] = prev[block];
+        }
+        free_order[block] = NOT_FREE;
+        counts[order]--;
+    }
+};
+
+#endif
@@ -1,4 +1,10 @@
 #include <iostream>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include "structured_output.hpp"
 
 #ifndef DATA_STRUCTURES
 #define DATA_STRUCTURES
@@ -21,7 +27,23 @@ enum PROC_CYCLES
     FOUTS,
     ZEROS,
     SEGV,
-    SEGPROT
+    SEGPROT,
+    PROMOTES,
+    DEMOTES,
+    BG_OUTS,
+    BG_FOUTS,
+    RA_INS,
+    RA_FINS,
+    RA_HITS,
+    RA_WASTED,
+    COW_COPIES,
+    ZSWAP_STORES,
+    ZSWAP_LOADS,
+    ZSWAP_REJECTS,
+    ZSWAP_WRITEBACKS,
+    WALKS,
+    TLB_HITS,
+    TLB_MISSES
 };
 
 // VALUES (Cant Store in ENUM as 410 occurs twice)
@@ -34,38 +56,105 @@ const unsigned int int_fouts = 2800;
 const unsigned int int_zeros = 150;
 const unsigned int int_segv = 440;
 const unsigned int int_segprot = 410;
+// Huge page promotion / demotion (PTE rewrite + TLB shootdown), priced like maps / unmaps
+const unsigned int int_promotes = 350;
+const unsigned int int_demotes = 410;
+// Breaking copy-on-write copies a whole page, twice the work of zeroing it
+const unsigned int int_cow_copies = 300;
+// Compressing a page takes a few copies worth of work, decompressing about one.
+// A rejected page was compressed for nothing, a pool write back decompresses before its OUT
+const unsigned int int_zswap_stores = 600;
+const unsigned int int_zswap_loads = 250;
+// Each page table level above the leaf costs one extra memory reference
+const unsigned int int_walks = 1;
+// TLB hits are free, a miss costs the refill on top of the page walk
+const unsigned int int_tlb_misses = 20;
+
+/* Address space geometry, fixed at compile time:
+   VPAGE_BITS -> virtual pages per process (NUM_PTE = 2^VPAGE_BITS)
+   FRAME_BITS -> width of a frame number (MAX_FRAMES = 2^FRAME_BITS)
+   PID_BITS   -> width of the pid stored in a PTE
+   PT_LEVELS  -> depth of the radix page table (1..4)
+   The defaults are the original lab limits (64 pages, 128 frames, 256 processes),
+   build with i.e. make SIZES="-DVPAGE_BITS=22 -DFRAME_BITS=20 -DPID_BITS=16" for large workloads */
+#ifndef VPAGE_BITS
+#define VPAGE_BITS 6
+#endif
+#ifndef FRAME_BITS
+#define FRAME_BITS 7
+#endif
+#ifndef PID_BITS
+#define PID_BITS 8
+#endif
+// Page table levels, 1 = the original flat table
+#ifndef PT_LEVELS
+#define PT_LEVELS 1
+#endif
+
+// Flag bits + pid + frame number, PTEs grow to 64 bits once these stop fitting in 32
+#define PTE_USED_BITS (10 + PID_BITS + FRAME_BITS)
+#if PTE_USED_BITS < 32
+typedef unsigned int pte_word_t;
+#define PTE_WORD_BITS 32
+#else
+typedef uint64_t pte_word_t;
+#define PTE_WORD_BITS 64
+#endif
+
+// vpage / frame numbers are passed around as int
+static_assert(VPAGE_BITS >= 1 && VPAGE_BITS <= 30, "VPAGE_BITS must be in 1..30");
+static_assert(FRAME_BITS >= 1 && FRAME_BITS <= 30, "FRAME_BITS must be in 1..30");
+static_assert(PTE_USED_BITS < 64, "PID_BITS + FRAME_BITS too wide for a 64 bit PTE");
+static_assert(PT_LEVELS >= 1 && PT_LEVELS <= 4 && PT_LEVELS <= VPAGE_BITS, "PT_LEVELS must be in 1..4");
 
 // Max number of page table entries
-const unsigned int NUM_PTE = 64;
+const unsigned int NUM_PTE = 1u << VPAGE_BITS;
+
+// Max number of physical frames (width of frame_number)
+const unsigned int MAX_FRAMES = 1u << FRAME_BITS;
+
+// Frame numbers above MAX_FRAMES would alias in the frame_number bitfields
+inline void check_frame_count(unsigned int num_frames)
+{
+    if (num_frames == 0 || num_frames > MAX_FRAMES)
+    {
+        throw std::invalid_argument("Number of frames must be in 1.." + std::to_string(MAX_FRAMES) +
+                                    " (FRAME_BITS=" + std::to_string(FRAME_BITS) + "): " + std::to_string(num_frames));
+    }
+}
 
 // VMA Range For Lazy Page initialization
 typedef struct vma_range
 {
-    unsigned int START : 7;
-    unsigned int END : 7;
-    unsigned int WRITE_PROTECT : 1;
-    unsigned int FILEMAPPED : 1; // File mapped Flag
+    pte_word_t START : VPAGE_BITS + 1;
+    pte_word_t END : VPAGE_BITS + 1;
+    pte_word_t WRITE_PROTECT : 1;
+    pte_word_t FILEMAPPED : 1; // File mapped Flag
 } vma_range;
 
 // VMA Page Bitfield structure -> Contains Protection Flags metadata and frame_number
 typedef struct pte_t
 {
     // Custom Protection / Flag bits
-    unsigned int UNUSED_BITS : 9;
-    unsigned int EXISTS : 1;
-    unsigned int PID : 8;
-    unsigned int NOT_FIRST_ACCESS : 1;
+    pte_word_t UNUSED_BITS : PTE_WORD_BITS - PTE_USED_BITS;
+    pte_word_t EXISTS : 1;
+    pte_word_t PID : PID_BITS;
+    pte_word_t NOT_FIRST_ACCESS : 1;
+    // Part of a promoted huge page
+    pte_word_t HUGE : 1;
+    // Frame shared with a forked process, a write gets a private copy
+    pte_word_t COW : 1;
 
     // Required Protection / Flag Bits
-    unsigned int PAGEDOUT : 1;
-    unsigned int PRESENT : 1;
-    unsigned int REFERENCED : 1;
-    unsigned int MODIFIED : 1;
-    unsigned int WRITE_PROTECT : 1;
-    unsigned int FILEMAPPED : 1;
-
-    // Page number bits (Supports 128 frames as maximum)
-    unsigned int frame_number : 7;
+    pte_word_t PAGEDOUT : 1;
+    pte_word_t PRESENT : 1;
+    pte_word_t REFERENCED : 1;
+    pte_word_t MODIFIED : 1;
+    pte_word_t WRITE_PROTECT : 1;
+    pte_word_t FILEMAPPED : 1;
+
+    // Page number bits (Supports MAX_FRAMES frames as maximum)
+    pte_word_t frame_number : FRAME_BITS;
 } pte_t;
 
 // Frame Table Struct - Stores Data for Reverse Mapping frame -> page
@@ -74,15 +163,334 @@ typedef struct frame_t
     // For Aging paging algorithm
     unsigned int age : 32;
     // Frame number
-    unsigned int frame_number : 7;
+    unsigned int frame_number : FRAME_BITS;
 
-    // Process id -- Extra bits used here so sizeof(frame_t) == sizeof(pte_t)
-    short process_id = -1;
+    // Process id -> using signed for -1 to indicate free
+    int process_id = -1;
 
-    // Frame number bits (Supports 64 frames as maximum) -> using signed for -1 to indicate free
-    short VMA_page_number = -1;
+    // Virtual page number (Supports NUM_PTE pages as maximum) -> using signed for -1 to indicate free
+    int VMA_page_number = -1;
 } frame_t;
 
+// Optional per process counters, shown for the features the pager has enabled
+typedef struct stats_options
+{
+    bool tlb;
+    bool huge;
+    bool writeback;
+    bool prefetch;
+    bool cow;
+    bool zswap;
+} stats_options;
+
+/* Sorted, non overlapping set of VMAs. Lookups binary search a compact array
+   of START keys (separate from the VMA records so the search stays in cache),
+   O(log n) per page fault. Ranges can be added and removed at runtime,
+   removal trims or splits VMAs the way munmap does. */
+class VmaIndex
+{
+public:
+    void reserve(size_t n)
+    {
+        starts.reserve(n);
+        vmas.reserve(n);
+    }
+
+    size_t size() const
+    {
+        return vmas.size();
+    }
+
+    // VMAs in START order
+    const vma_range &at(size_t i) const
+    {
+        return vmas[i];
+    }
+
+    // VMA containing vpage or nullptr
+    inline const vma_range *find(unsigned int vpage) const
+    {
+        size_t i = upper(vpage);
+        // i - 1 is the last VMA starting at or before vpage
+        if (i > 0 && vpage <= vmas[i - 1].END)
+        {
+            return &vmas[i - 1];
+        }
+        return nullptr;
+    }
+
+    // Inserts a VMA, returns false (and leaves the index untouched) if it overlaps another one
+    bool add(const vma_range &vma)
+    {
+        if (vma.END < vma.START)
+        {
+            return false;
+        }
+        size_t i = upper(vma.START);
+        if ((i > 0 && vmas[i - 1].END >= vma.START) || (i < vmas.size() && vmas[i].START <= vma.END))
+        {
+            return false;
+        }
+        starts.insert(starts.begin() + i, vma.START);
+        vmas.insert(vmas.begin() + i, vma);
+        return true;
+    }
+
+    // Removes [start, end] from the index, trimming or splitting the VMAs it cuts through
+    void remove(unsigned int start, unsigned int end)
+    {
+        if (end < start)
+        {
+            return;
+        }
+        // First VMA that can reach start
+        size_t i = upper(start);
+        if (i > 0 && vmas[i - 1].END >= start)
+        {
+            i--;
+        }
+        while (i < vmas.size() && vmas[i].START <= end)
+        {
+            vma_range vma = vmas[i];
+            bool keep_head = vma.START < start;
+            bool keep_tail = vma.END > end;
+            if (keep_head && keep_tail)
+            {
+                // Hole in the middle, split in two
+                vmas[i].END = start - 1;
+                vma_range tail = vma;
+                tail.START = end + 1;
+                starts.insert(starts.begin() + i + 1, tail.START);
+                vmas.insert(vmas.begin() + i + 1, tail);
+                return;
+            }
+            if (keep_head)
+            {
+                vmas[i].END = start - 1;
+                i++;
+            }
+            else if (keep_tail)
+            {
+                vmas[i].START = end + 1;
+                starts[i] = end + 1;
+                return;
+            }
+            else
+            {
+                starts.erase(starts.begin() + i);
+                vmas.erase(vmas.begin() + i);
+            }
+        }
+    }
+
+private:
+    std::vector<unsigned int> starts;
+    std::vector<vma_range> vmas;
+
+    // Index of the first VMA starting after vpage
+    inline size_t upper(unsigned int vpage) const
+    {
+        return std::upper_bound(starts.begin(), starts.end(), vpage) - starts.begin();
+    }
+};
+
+// Fixed size block allocator for page table nodes. Blocks are carved from slabs
+// that double in size (slab s holds 2^s blocks) and named by a 1 based id (0 = none),
+// so pointers stay valid as the pool grows and a copied pool needs no fix ups
+template <typename T>
+class NodePool
+{
+public:
+    void init(unsigned int block_size_)
+    {
+        block_size = block_size_;
+        slabs.clear();
+        reset();
+    }
+
+    // Returns every block to the pool, slabs are kept for reuse
+    void reset()
+    {
+        free_ids.clear();
+        next_id = 1;
+    }
+
+    // Zero filled block
+    uint32_t allocate()
+    {
+        uint32_t id;
+        if (!free_ids.empty())
+        {
+            id = free_ids.back();
+            free_ids.pop_back();
+        }
+        else
+        {
+            id = next_id++;
+            if (slab_of(id) == slabs.size())
+            {
+                slabs.push_back(std::vector<T>((size_t)block_size << slabs.size()));
+            }
+        }
+        T *block = get(id);
+        std::fill(block, block + block_size, T());
+        return id;
+    }
+
+    void release(uint32_t id)
+    {
+        free_ids.push_back(id);
+    }
+
+    inline T *get(uint32_t id)
+    {
+        unsigned int slab = slab_of(id);
+        return &slabs[slab][(size_t)(id - (1u << slab)) * block_size];
+    }
+
+    size_t blocks_in_use() const
+    {
+        return next_id - 1 - free_ids.size();
+    }
+
+private:
+    unsigned int block_size = 1;
+    std::vector<std::vector<T> > slabs;
+    std::vector<uint32_t> free_ids;
+    uint32_t next_id = 1;
+
+    static inline unsigned int slab_of(uint32_t id)
+    {
+        return 31 - __builtin_clz(id);
+    }
+};
+
+/* Radix page table: VPAGE_BITS are split over PT_LEVELS levels (lower levels
+   take the remainder bits), interior nodes hold child ids and only the leaves
+   covering touched pages are allocated. With one level the root is the leaf,
+   i.e. the original flat page table. */
+class RadixPageTable
+{
+public:
+    void init(unsigned int levels_)
+    {
+        levels = levels_;
+        unsigned int interior_bits = 0;
+        for (unsigned int l = 0; l < levels; l++)
+        {
+            bits[l] = VPAGE_BITS / levels + (l >= levels - VPAGE_BITS % levels ? 1 : 0);
+            if (l + 1 < levels)
+            {
+                interior_bits = std::max(interior_bits, bits[l]);
+            }
+        }
+        shift[levels - 1] = 0;
+        for (int l = levels - 2; l >= 0; l--)
+        {
+            shift[l] = shift[l + 1] + bits[l + 1];
+        }
+        interior.init(1u << interior_bits);
+        leaves.init(1u << bits[levels - 1]);
+        clear();
+    }
+
+    // Drops every entry, leaving only an empty root
+    void clear()
+    {
+        interior.reset();
+        leaves.reset();
+        root = levels == 1 ? leaves.allocate() : interior.allocate();
+    }
+
+    // PTE for vpage, nullptr if its leaf was never allocated
+    // depth = number of nodes visited, including the leaf
+    inline pte_t *find(unsigned int vpage, unsigned int &depth)
+    {
+        uint32_t id = root;
+        for (unsigned int l = 0; l + 1 < levels; l++)
+        {
+            id = interior.get(id)[index(vpage, l)];
+            if (!id)
+            {
+                depth = l + 1;
+                return nullptr;
+            }
+        }
+        depth = levels;
+        return &leaves.get(id)[index(vpage, levels - 1)];
+    }
+
+    inline pte_t *find(unsigned int vpage)
+    {
+        unsigned int depth;
+        return find(vpage, depth);
+    }
+
+    // PTE for vpage, allocating the missing nodes on the way down
+    pte_t *walk(unsigned int vpage)
+    {
+        uint32_t id = root;
+        for (unsigned int l = 0; l + 1 < levels; l++)
+        {
+            uint32_t child = interior.get(id)[index(vpage, l)];
+            if (!child)
+            {
+                child = l + 2 < levels ? interior.allocate() : leaves.allocate();
+                interior.get(id)[index(vpage, l)] = child;
+            }
+            id = child;
+        }
+        return &leaves.get(id)[index(vpage, levels - 1)];
+    }
+
+    // Calls fn(vpage, pte) for every entry of the allocated leaves, in vpage order
+    template <typename F>
+    void for_each(F fn)
+    {
+        visit(0, root, 0, fn);
+    }
+
+    size_t allocated_nodes() const
+    {
+        return interior.blocks_in_use() + leaves.blocks_in_use();
+    }
+
+private:
+    unsigned int levels = 1;
+    unsigned int bits[4];
+    unsigned int shift[4];
+    uint32_t root = 0;
+    NodePool<uint32_t> interior;
+    NodePool<pte_t> leaves;
+
+    inline unsigned int index(unsigned int vpage, unsigned int level) const
+    {
+        return (vpage >> shift[level]) & ((1u << bits[level]) - 1);
+    }
+
+    template <typename F>
+    void visit(unsigned int level, uint32_t id, unsigned int base, F &fn)
+    {
+        unsigned int entries = 1u << bits[level];
+        if (level + 1 == levels)
+        {
+            for (unsigned int i = 0; i < entries; i++)
+            {
+                fn((int)(base | i), &leaves.get(id)[i]);
+            }
+            return;
+        }
+        for (unsigned int i = 0; i < entries; i++)
+        {
+            uint32_t child = interior.get(id)[i];
+            if (child)
+            {
+                visit(level + 1, child, base | (i << shift[level]), fn);
+            }
+        }
+    }
+};
+
 class Process
 {
     static unsigned int counter;
@@ -91,16 +499,13 @@ public:
     Process()
     {
         pid = counter++;
-        init_set_all_pte_to_zero();
+        page_table.init(PT_LEVELS);
     }
 
+    // Frees the whole page table, every PTE reads as zero afterwards
     void init_set_all_pte_to_zero()
     {
-        // NECESSARY TO RUN CORRECTLY ON LINSERV
-        for (unsigned int i = 0; i < NUM_PTE; i++)
-        {
-            set_all_to_zero(&page_table_arr[i]);
-        }
+        page_table.clear();
     }
 
     void set_all_to_zero(pte_t *page_entry)
@@ -109,6 +514,8 @@ public:
         page_entry->EXISTS = 0;
         page_entry->PID = 0;
         page_entry->NOT_FIRST_ACCESS = 0;
+        page_entry->HUGE = 0;
+        page_entry->COW = 0;
         page_entry->PAGEDOUT = 0;
         page_entry->PRESENT = 0;
         page_entry->REFERENCED = 0;
@@ -120,38 +527,73 @@ public:
     // Initializes array of VMA Ranges used for PTE creation on pagefault
     void init_vma(const int num_vmas_)
     {
-        num_vmas = num_vmas_;
-        vma_arr = new vma_range[num_vmas];
+        vmas.reserve(num_vmas_);
     }
 
     // Adds VMA range specs per input to the VMA array
     void add_vma(const unsigned int vma_num, const int start_vpage, const int end_vpage, const int write_protected, const int file_mapped)
     {
         // Set VMA range (NOT PTE) in Process
-        vma_arr[vma_num].START = start_vpage;
-        vma_arr[vma_num].END = end_vpage;
-        vma_arr[vma_num]
-            .WRITE_PROTECT = write_protected;
-        vma_arr[vma_num].FILEMAPPED = file_mapped;
+        vma_range vma;
+        vma.START = start_vpage;
+        vma.END = end_vpage;
+        vma.WRITE_PROTECT = write_protected;
+        vma.FILEMAPPED = file_mapped;
+        if (!vmas.add(vma))
+        {
+            throw std::invalid_argument("Invalid or overlapping VMA " + std::to_string(vma_num) + " of process " + std::to_string(pid));
+        }
+    }
+
+    // Removes [start_vpage, end_vpage] from the address space (munmap)
+    // Present pages in the range have to be unmapped by the caller first
+    void remove_vma(const int start_vpage, const int end_vpage)
+    {
+        vmas.remove(start_vpage, end_vpage);
+        // Forget cached VMA flags so the next access re-checks the index
+        for_each_pte([start_vpage, end_vpage](int vpage, pte_t *entry)
+                     {
+            if (vpage >= start_vpage && vpage <= end_vpage && !entry->PRESENT)
+            {
+                entry->EXISTS = 0;
+            } });
+    }
+
+    // Fork: takes over the parent's VMAs and a copy of its page table. Present
+    // entries keep pointing at the parent's frames, the caller makes those shared.
+    // R / M / HUGE stay with the parent's mapping.
+    void copy_address_space(Process &parent)
+    {
+        vmas = parent.vmas;
+        page_table.clear();
+        parent.for_each_pte([this](int vpage, pte_t *entry)
+                            {
+            if (entry->EXISTS)
+            {
+                pte_t *copy = page_table.walk(vpage);
+                *copy = *entry;
+                copy->REFERENCED = 0;
+                copy->MODIFIED = 0;
+                copy->HUGE = 0;
+            } });
+    }
+
+    // Returns the VMA containing vpage or nullptr
+    const vma_range *find_vma(const unsigned int vpage) const
+    {
+        return vmas.find(vpage);
     }
 
     // Helper function to check if a VMA exists on pagefault
     bool vma_exists(const unsigned int vma_query)
     {
-        for (unsigned int i = 0; i < num_vmas; i++)
-        {
-            vma_range temp = vma_arr[i];
-            if (vma_query >= temp.START && vma_query <= temp.END)
-            {
-                return true;
-            }
-        }
-        return false;
+        return find_vma(vma_query) != nullptr;
     }
 
     bool check_present_valid(int vpage)
     {
-        if (page_table_arr[vpage].PRESENT)
+        const pte_t *entry = page_table.find(vpage);
+        if (entry && entry->PRESENT)
         {
             return true;
         }
@@ -162,7 +604,8 @@ public:
     {
         // First check the Page table page entry and see if exists has been
         // Turned on in the bit-field
-        if (page_table_arr[vpage].EXISTS)
+        const pte_t *entry = page_table.find(vpage);
+        if (entry && entry->EXISTS)
         {
             return true;
         }
@@ -170,24 +613,79 @@ public:
         return vma_exists(vpage);
     }
 
+    // Accessors below leave pages without an allocated leaf alone, those never got
+    // past the VMA check so their bits are never looked at
     void set_referenced(int vpage)
     {
-        page_table_arr[vpage].REFERENCED = 1;
+        pte_t *entry = page_table.find(vpage);
+        if (entry)
+        {
+            entry->REFERENCED = 1;
+        }
+    }
+
+    unsigned int get_frame_num(int vpage)
+    {
+        const pte_t *entry = page_table.find(vpage);
+        return entry ? entry->frame_number : 0;
     }
 
     void set_frame_num(int vpage, int framenum)
     {
-        page_table_arr[vpage].frame_number = (unsigned int)framenum;
+        page_table.walk(vpage)->frame_number = (unsigned int)framenum;
     }
 
     void set_write(int vpage)
     {
-        page_table_arr[vpage].MODIFIED = 1;
+        pte_t *entry = page_table.find(vpage);
+        if (entry)
+        {
+            entry->MODIFIED = 1;
+        }
     }
 
     unsigned int write_protect_enabled(int vpage)
     {
-        return page_table_arr[vpage].WRITE_PROTECT;
+        const pte_t *entry = page_table.find(vpage);
+        return entry ? entry->WRITE_PROTECT : 0;
+    }
+
+    // True if bringing vpage in means reading it (file mapped or paged out) rather than zeroing it
+    bool has_backing_store(int vpage)
+    {
+        const pte_t *entry = page_table.find(vpage);
+        if (entry && entry->EXISTS)
+        {
+            return entry->FILEMAPPED || entry->PAGEDOUT;
+        }
+        const vma_range *vma = find_vma(vpage);
+        return vma && vma->FILEMAPPED;
+    }
+
+    bool is_huge(int vpage)
+    {
+        const pte_t *entry = page_table.find(vpage);
+        return entry && entry->HUGE;
+    }
+
+    // Charges the page table levels above the leaf visited while translating vpage
+    void count_page_walk(int vpage)
+    {
+        unsigned int depth;
+        page_table.find(vpage, depth);
+        walks += depth - 1;
+    }
+
+    // Calls fn(vpage, pte) for every PTE backed by an allocated leaf, in vpage order
+    template <typename F>
+    void for_each_pte(F fn)
+    {
+        page_table.for_each(fn);
+    }
+
+    size_t page_table_nodes() const
+    {
+        return page_table.allocated_nodes();
     }
 
     // TODO: Update for desired output
@@ -200,9 +698,11 @@ public:
         std::string M = "M";
         std::string S = "S";
 
-        for (int i = 0; i < NUM_PTE; i++)
+        const pte_t zero_entry = pte_t();
+        for (unsigned int i = 0; i < NUM_PTE; i++)
         {
-            pte_t entry = page_table_arr[i];
+            const pte_t *found = page_table.find(i);
+            pte_t entry = found ? *found : zero_entry;
             if (entry.PRESENT)
             {
                 const char *r = entry.REFERENCED ? R.c_str() : dash.c_str();
@@ -230,34 +730,34 @@ public:
     // Temp function to help validate input
     void print_vma_ranges()
     {
-        printf("Total Number of VMA Ranges: %d\n", num_vmas);
-        for (int i = 0; i < num_vmas; i++)
+        printf("Total Number of VMA Ranges: %d\n", (int)vmas.size());
+        for (size_t i = 0; i < vmas.size(); i++)
         {
+            const vma_range &vma = vmas.at(i);
             printf("Start: %d Stop: %d Write: %d File: %d\n",
-                   vma_arr[i].START, vma_arr[i].END, vma_arr[i].WRITE_PROTECT, vma_arr[i].FILEMAPPED);
+                   (int)vma.START, (int)vma.END, (int)vma.WRITE_PROTECT, (int)vma.FILEMAPPED);
         }
     }
 
     void pte_init(int vpage_num)
     {
-        for (int i = 0; i < num_vmas; i++)
+        const vma_range *vma = find_vma(vpage_num);
+        if (vma)
         {
-            vma_range temp = vma_arr[i];
-            if (vpage_num >= temp.START && vpage_num <= temp.END)
-            {
-                page_table_arr[vpage_num].EXISTS = 1;
-                page_table_arr[vpage_num].WRITE_PROTECT = temp.WRITE_PROTECT;
-                page_table_arr[vpage_num].FILEMAPPED = temp.FILEMAPPED;
-            }
+            pte_t *entry = page_table.walk(vpage_num);
+            entry->EXISTS = 1;
+            entry->WRITE_PROTECT = vma->WRITE_PROTECT;
+            entry->FILEMAPPED = vma->FILEMAPPED;
         }
     }
     pte_t *get_vpage(int vpage_num)
     {
-        if (!page_table_arr[vpage_num].EXISTS)
+        pte_t *entry = page_table.walk(vpage_num);
+        if (!entry->EXISTS)
         {
             pte_init(vpage_num);
         }
-        return &page_table_arr[vpage_num];
+        return entry;
     }
 
     void allocate_cost(PROC_CYCLES cost_type)
@@ -291,20 +791,272 @@ public:
         case SEGPROT:
             segprot++;
             break;
+        case PROMOTES:
+            promotes++;
+            break;
+        case BG_OUTS:
+            bg_outs++;
+            break;
+        case BG_FOUTS:
+            bg_fouts++;
+            break;
+        case RA_INS:
+            ra_ins++;
+            break;
+        case RA_FINS:
+            ra_fins++;
+            break;
+        case RA_HITS:
+            ra_hits++;
+            break;
+        case RA_WASTED:
+            ra_wasted++;
+            break;
+        case COW_COPIES:
+            cow_copies++;
+            break;
+        case ZSWAP_STORES:
+            zswap_stores++;
+            break;
+        case ZSWAP_LOADS:
+            zswap_loads++;
+            break;
+        case ZSWAP_REJECTS:
+            zswap_rejects++;
+            break;
+        case ZSWAP_WRITEBACKS:
+            zswap_writebacks++;
+            break;
+        case DEMOTES:
+            demotes++;
+            break;
+        case WALKS:
+            walks++;
+            break;
+        case TLB_HITS:
+            tlb_hits++;
+            break;
+        case TLB_MISSES:
+            tlb_misses++;
+            break;
         }
     }
 
-    void print_stats()
+    // Number of events counted so far for one cost category
+    unsigned long get_count(PROC_CYCLES cost_type) const
     {
-        printf("U=%lu M=%lu I=%lu O=%lu FI=%lu FO=%lu Z=%lu SV=%lu SP=%lu\n", unmaps, maps, ins, outs, fins, fouts, zeros, segv, segprot);
+        switch (cost_type)
+        {
+        case UNMAPS:
+            return unmaps;
+        case MAPS:
+            return maps;
+        case INS:
+            return ins;
+        case OUTS:
+            return outs;
+        case FINS:
+            return fins;
+        case FOUTS:
+            return fouts;
+        case ZEROS:
+            return zeros;
+        case SEGV:
+            return segv;
+        case SEGPROT:
+            return segprot;
+        case PROMOTES:
+            return promotes;
+        case BG_OUTS:
+            return bg_outs;
+        case BG_FOUTS:
+            return bg_fouts;
+        case RA_INS:
+            return ra_ins;
+        case RA_FINS:
+            return ra_fins;
+        case RA_HITS:
+            return ra_hits;
+        case RA_WASTED:
+            return ra_wasted;
+        case COW_COPIES:
+            return cow_copies;
+        case ZSWAP_STORES:
+            return zswap_stores;
+        case ZSWAP_LOADS:
+            return zswap_loads;
+        case ZSWAP_REJECTS:
+            return zswap_rejects;
+        case ZSWAP_WRITEBACKS:
+            return zswap_writebacks;
+        case DEMOTES:
+            return demotes;
+        case WALKS:
+            return walks;
+        case TLB_HITS:
+            return tlb_hits;
+        case TLB_MISSES:
+            return tlb_misses;
+        }
+        return 0;
     }
+
+    void print_stats(FILE *out, const stats_options &show)
+    {
+        fprintf(out, "U=%lu M=%lu I=%lu O=%lu FI=%lu FO=%lu Z=%lu SV=%lu SP=%lu", unmaps, maps, ins, outs, fins, fouts, zeros, segv, segprot);
+        // Page walk steps only exist with a multi level page table
+        if (PT_LEVELS > 1)
+        {
+            fprintf(out, " PW=%lu", walks);
+        }
+        if (show.huge)
+        {
+            fprintf(out, " HP=%lu HD=%lu", promotes, demotes);
+        }
+        if (show.tlb)
+        {
+            fprintf(out, " TH=%lu TM=%lu", tlb_hits, tlb_misses);
+        }
+        if (show.writeback)
+        {
+            fprintf(out, " BO=%lu BFO=%lu", bg_outs, bg_fouts);
+        }
+        if (show.prefetch)
+        {
+            // Pages read ahead, of those touched later / dropped untouched
+            fprintf(out, " RA=%lu RU=%lu RW=%lu", ra_ins + ra_fins, ra_hits, ra_wasted);
+        }
+        if (show.cow)
+        {
+            fprintf(out, " CW=%lu", cow_copies);
+        }
+        if (show.zswap)
+        {
+            // Compressed pool stores, loads, rejected pages, write backs to disk
+            fprintf(out, " ZS=%lu ZL=%lu ZR=%lu ZW=%lu", zswap_stores, zswap_loads, zswap_rejects, zswap_writebacks);
+        }
+        fprintf(out, "\n");
+    }
+
+    // Same counters as print_stats as one "process" record, plus the process's cost
+    void write_stats(StructuredWriter &out, const stats_options &show)
+    {
+        out.field("unmaps", unmaps);
+        out.field("maps", maps);
+        out.field("ins", ins);
+        out.field("outs", outs);
+        out.field("fins", fins);
+        out.field("fouts", fouts);
+        out.field("zeros", zeros);
+        out.field("segv", segv);
+        out.field("segprot", segprot);
+        if (PT_LEVELS > 1)
+        {
+            out.field("walks", walks);
+        }
+        if (show.huge)
+        {
+            out.field("promotes", promotes);
+            out.field("demotes", demotes);
+        }
+        if (show.tlb)
+        {
+            out.field("tlb_hits", tlb_hits);
+            out.field("tlb_misses", tlb_misses);
+        }
+        if (show.writeback)
+        {
+            out.field("bg_outs", bg_outs);
+            out.field("bg_fouts", bg_fouts);
+        }
+        if (show.prefetch)
+        {
+            out.field("ra_reads", ra_ins + ra_fins);
+            out.field("ra_hits", ra_hits);
+            out.field("ra_wasted", ra_wasted);
+        }
+        if (show.cow)
+        {
+            out.field("cow_copies", cow_copies);
+        }
+        if (show.zswap)
+        {
+            out.field("zswap_stores", zswap_stores);
+            out.field("zswap_loads", zswap_loads);
+            out.field("zswap_rejects", zswap_rejects);
+            out.field("zswap_writebacks", zswap_writebacks);
+        }
+        out.field("cost", calc_total_cost());
+    }
+
     unsigned int get_pid()
     {
         return pid;
     }
 
+    unsigned long get_read_aheads() const
+    {
+        return ra_ins + ra_fins;
+    }
+
+    unsigned long get_read_ahead_hits() const
+    {
+        return ra_hits;
+    }
+
+    unsigned long get_read_ahead_wasted() const
+    {
+        return ra_wasted;
+    }
+
+    unsigned long get_tlb_hits() const
+    {
+        return tlb_hits;
+    }
+
+    unsigned long get_tlb_misses() const
+    {
+        return tlb_misses;
+    }
+
+    // Cycles spent in the fault path (foreground latency seen by the process)
+    unsigned long long fault_cycles() const
+    {
+        unsigned long long cycles = 0;
+        cycles += unmaps * int_unmaps;
+        cycles += maps * int_maps;
+        cycles += ins * int_ins;
+        cycles += outs * int_outs;
+        cycles += fins * int_fins;
+        cycles += fouts * int_fouts;
+        cycles += zeros * int_zeros;
+        cycles += cow_copies * int_cow_copies;
+        cycles += zswap_cycles();
+        return cycles;
+    }
+
+    // Write back I/O done by the page cleaner, overlapped with execution so not part of calc_total_cost
+    unsigned long long background_cycles() const
+    {
+        return bg_outs * int_outs + bg_fouts * int_fouts;
+    }
+
+    // Reads issued by read-ahead, asynchronous so not part of calc_total_cost either
+    unsigned long long read_ahead_cycles() const
+    {
+        return ra_ins * int_ins + ra_fins * int_fins;
+    }
+
+    // CPU time of the compressed pool, part of the fault path
+    unsigned long long zswap_cycles() const
+    {
+        return (zswap_stores + zswap_rejects) * int_zswap_stores + (zswap_loads + zswap_writebacks) * int_zswap_loads;
+    }
+
     unsigned long long calc_total_cost()
     {
+        // Recomputed from the counters so repeated calls don't double count
+        total_cost = 0;
         total_cost += unmaps * int_unmaps;
         total_cost += maps * int_maps;
         total_cost += ins * int_ins;
@@ -314,14 +1066,19 @@ public:
         total_cost += zeros * int_zeros;
         total_cost += segv * int_segv;
         total_cost += segprot * int_segprot;
+        total_cost += promotes * int_promotes;
+        total_cost += demotes * int_demotes;
+        total_cost += cow_copies * int_cow_copies;
+        total_cost += zswap_cycles();
+        total_cost += walks * int_walks;
+        total_cost += tlb_misses * int_tlb_misses;
         return total_cost;
     }
 
 private:
     unsigned int pid = 0;
-    int num_vmas = 0;
-    vma_range *vma_arr;
-    pte_t page_table_arr[NUM_PTE];
+    VmaIndex vmas;
+    RadixPageTable page_table;
     unsigned long long total_cost = 0;
     unsigned long unmaps = 0;
     unsigned long maps = 0;
@@ -332,8 +1089,450 @@ private:
     unsigned long zeros = 0;
     unsigned long segv = 0;
     unsigned long segprot = 0;
+    unsigned long promotes = 0;
+    unsigned long bg_outs = 0;
+    unsigned long bg_fouts = 0;
+    unsigned long ra_ins = 0;
+    unsigned long ra_fins = 0;
+    unsigned long ra_hits = 0;
+    unsigned long ra_wasted = 0;
+    unsigned long cow_copies = 0;
+    unsigned long zswap_stores = 0;
+    unsigned long zswap_loads = 0;
+    unsigned long zswap_rejects = 0;
+    unsigned long zswap_writebacks = 0;
+    unsigned long demotes = 0;
+    unsigned long walks = 0;
+    unsigned long tlb_hits = 0;
+    unsigned long tlb_misses = 0;
 };
 
 unsigned int Process::counter = 0;
 
-#endif
\ No newline at end of file
+// Key identifying a virtual page across processes, used by history / ghost lists
+inline uint64_t page_key(unsigned int pid, unsigned int vpage)
+{
+    return ((uint64_t)pid << 32) | vpage;
+}
+
+// Dense bit per frame, scanned a 64 bit word at a time
+class FrameBitmap
+{
+public:
+    void init(unsigned int num_bits_)
+    {
+        num_bits = num_bits_;
+        words.assign((num_bits + 63) / 64, 0);
+    }
+
+    inline bool test(unsigned int i) const
+    {
+        return (words[i >> 6] >> (i & 63)) & 1;
+    }
+
+    inline void set(unsigned int i)
+    {
+        words[i >> 6] |= 1ULL << (i & 63);
+    }
+
+    inline void reset(unsigned int i)
+    {
+        words[i >> 6] &= ~(1ULL << (i & 63));
+    }
+
+    inline void assign(unsigned int i, bool value)
+    {
+        if (value)
+        {
+            set(i);
+        }
+        else
+        {
+            reset(i);
+        }
+    }
+
+    inline uint64_t word(size_t w) const
+    {
+        return words[w];
+    }
+
+    void reset_all()
+    {
+        std::fill(words.begin(), words.end(), 0);
+    }
+
+    // Clears bits [from, to)
+    void reset_range(unsigned int from, unsigned int to)
+    {
+        while (from < to)
+        {
+            size_t w = from >> 6;
+            unsigned int word_end = (unsigned int)((w + 1) << 6);
+            unsigned int end = to < word_end ? to : word_end;
+            uint64_t mask = ~0ULL << (from & 63);
+            if (end & 63)
+            {
+                mask &= ~(~0ULL << (end & 63));
+            }
+            words[w] &= ~mask;
+            from = end;
+        }
+    }
+
+    // Clears bits [from, to) wrapping around the end, from == to clears nothing
+    void reset_range_wrapping(unsigned int from, unsigned int to)
+    {
+        if (from <= to)
+        {
+            reset_range(from, to);
+        }
+        else
+        {
+            reset_range(from, num_bits);
+            reset_range(0, to);
+        }
+    }
+
+private:
+    unsigned int num_bits = 0;
+    std::vector<uint64_t> words;
+};
+
+// First index in [from, to) whose bit is set in word_fn(word_index), to if there is none
+// word_fn combines bitmaps a word at a time, i.e. ~R & ~M for "unreferenced and clean"
+template <typename WordFn>
+unsigned int find_first_bit(unsigned int from, unsigned int to, WordFn word_fn)
+{
+    while (from < to)
+    {
+        size_t w = from >> 6;
+        uint64_t word = word_fn(w) & (~0ULL << (from & 63));
+        if (word)
+        {
+            unsigned int index = (unsigned int)(w << 6) + __builtin_ctzll(word);
+            return index < to ? index : to;
+        }
+        from = (unsigned int)((w + 1) << 6);
+    }
+    return to;
+}
+
+// Same as find_first_bit over [start, n) then [0, start), n if there is none
+template <typename WordFn>
+unsigned int find_first_bit_wrapping(unsigned int start, unsigned int n, WordFn word_fn)
+{
+    unsigned int index = find_first_bit(start, n, word_fn);
+    if (index < n)
+    {
+        return index;
+    }
+    index = find_first_bit(0, start, word_fn);
+    return index < start ? index : n;
+}
+
+// Index based doubly linked list over frame numbers (or any dense slot index)
+// O(1) insert / remove / move, an index is in at most one position of a list
+class FrameList
+{
+public:
+    void init(unsigned int num_frames)
+    {
+        prev.assign(num_frames, NIL);
+        next.assign(num_frames, NIL);
+        member.assign(num_frames, false);
+        head = tail = NIL;
+        count = 0;
+    }
+
+    bool contains(int frame_number) const
+    {
+        return member[frame_number];
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    unsigned int size() const
+    {
+        return count;
+    }
+
+    int front() const
+    {
+        return head;
+    }
+
+    int back() const
+    {
+        return tail;
+    }
+
+    // Successor of an index in the list, -1 past the back
+    int next_of(int frame_number) const
+    {
+        return next[frame_number];
+    }
+
+    void push_front(int frame_number)
+    {
+        prev[frame_number] = NIL;
+        next[frame_number] = head;
+        if (head != NIL)
+        {
+            prev[head] = frame_number;
+        }
+        head = frame_number;
+        if (tail == NIL)
+        {
+            tail = frame_number;
+        }
+        member[frame_number] = true;
+        count++;
+    }
+
+    void push_back(int frame_number)
+    {
+        next[frame_number] = NIL;
+        prev[frame_number] = tail;
+        if (tail != NIL)
+        {
+            next[tail] = frame_number;
+        }
+        tail = frame_number;
+        if (head == NIL)
+        {
+            head = frame_number;
+        }
+        member[frame_number] = true;
+        count++;
+    }
+
+    // Inserts frame_number right before position (which must be in the list)
+    void insert_before(int position, int frame_number)
+    {
+        if (position == head)
+        {
+            push_front(frame_number);
+            return;
+        }
+        prev[frame_number] = prev[position];
+        next[frame_number] = position;
+        next[prev[position]] = frame_number;
+        prev[position] = frame_number;
+        member[frame_number] = true;
+        count++;
+    }
+
+    // No-op if the frame isn't in this list
+    void remove(int frame_number)
+    {
+        if (!member[frame_number])
+        {
+            return;
+        }
+        if (prev[frame_number] != NIL)
+        {
+            next[prev[frame_number]] = next[frame_number];
+        }
+        else
+        {
+            head = next[frame_number];
+        }
+        if (next[frame_number] != NIL)
+        {
+            prev[next[frame_number]] = prev[frame_number];
+        }
+        else
+        {
+            tail = prev[frame_number];
+        }
+        prev[frame_number] = NIL;
+        next[frame_number] = NIL;
+        member[frame_number] = false;
+        count--;
+    }
+
+private:
+    const int NIL = -1;
+    std::vector<int> prev;
+    std::vector<int> next;
+    std::vector<bool> member;
+    int head = -1;
+    int tail = -1;
+    unsigned int count = 0;
+};
+
+// Fixed capacity open addressing map: page key -> slot index
+// Sized once up front so lookups / inserts / erases never allocate
+class PageKeyMap
+{
+public:
+    void init(unsigned int capacity)
+    {
+        // Power of two table at most half full
+        size_t table_size = 1;
+        while (table_size < 2 * (size_t)(capacity ? capacity : 1))
+        {
+            table_size <<= 1;
+        }
+        keys.assign(table_size, 0);
+        values.assign(table_size, EMPTY);
+        table_mask = table_size - 1;
+    }
+
+    // Slot index stored for key, -1 if absent
+    int find(uint64_t key) const
+    {
+        size_t slot = hash(key);
+        while (values[slot] != EMPTY)
+        {
+            if (keys[slot] == key)
+            {
+                return values[slot];
+            }
+            slot = (slot + 1) & table_mask;
+        }
+        return EMPTY;
+    }
+
+    // Key must not already be present
+    void insert(uint64_t key, int value)
+    {
+        size_t slot = hash(key);
+        while (values[slot] != EMPTY)
+        {
+            slot = (slot + 1) & table_mask;
+        }
+        keys[slot] = key;
+        values[slot] = value;
+    }
+
+    // No-op if key isn't present
+    void erase(uint64_t key)
+    {
+        size_t slot = hash(key);
+        while (values[slot] != EMPTY)
+        {
+            if (keys[slot] == key)
+            {
+                erase_slot(slot);
+                return;
+            }
+            slot = (slot + 1) & table_mask;
+        }
+    }
+
+private:
+    const int EMPTY = -1;
+    std::vector<uint64_t> keys;
+    std::vector<int> values;
+    size_t table_mask = 0;
+
+    inline size_t hash(uint64_t key) const
+    {
+        // Fibonacci hashing mixes pid (high bits) and vpage (low bits)
+        return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & table_mask;
+    }
+
+    // Backward shift deletion keeps probe chains intact without tombstones
+    void erase_slot(size_t hole)
+    {
+        size_t probe = (hole + 1) & table_mask;
+        while (values[probe] != EMPTY)
+        {
+            size_t home = hash(keys[probe]);
+            // Move the entry back if its home isn't cyclically within (hole, probe]
+            if (((probe - home) & table_mask) >= ((probe - hole) & table_mask))
+            {
+                keys[hole] = keys[probe];
+                values[hole] = values[probe];
+                hole = probe;
+            }
+            probe = (probe + 1) & table_mask;
+        }
+        values[hole] = EMPTY;
+    }
+};
+
+// Fixed capacity, recency ordered set of page keys (non resident history)
+// Nodes come from a pool sized up front + a PageKeyMap index -> no allocation per operation
+// Pushing into a full list drops its oldest entry
+class GhostList
+{
+public:
+    void init(unsigned int capacity_)
+    {
+        capacity = capacity_ ? capacity_ : 1;
+        keys.assign(capacity, 0);
+        order.init(capacity);
+        index.init(capacity);
+        free_nodes.clear();
+        for (int i = capacity - 1; i >= 0; i--)
+        {
+            free_nodes.push_back(i);
+        }
+    }
+
+    bool contains(uint64_t key) const
+    {
+        return index.find(key) != -1;
+    }
+
+    unsigned int size() const
+    {
+        return order.size();
+    }
+
+    bool empty() const
+    {
+        return order.empty();
+    }
+
+    // Inserts key as most recent entry
+    void push_front(uint64_t key)
+    {
+        if (order.size() == capacity)
+        {
+            pop_back();
+        }
+        int node = free_nodes.back();
+        free_nodes.pop_back();
+        keys[node] = key;
+        order.push_front(node);
+        index.insert(key, node);
+    }
+
+    // Drops the oldest entry
+    void pop_back()
+    {
+        if (!order.empty())
+        {
+            remove(keys[order.back()]);
+        }
+    }
+
+    // No-op if key isn't present
+    void remove(uint64_t key)
+    {
+        int node = index.find(key);
+        if (node == -1)
+        {
+            return;
+        }
+        index.erase(key);
+        order.remove(node);
+        free_nodes.push_back(node);
+    }
+
+private:
+    unsigned int capacity = 0;
+    std::vector<uint64_t> keys;
+    std::vector<int> free_nodes;
+    FrameList order;
+    PageKeyMap index;
+};
+
+#endif
@@ -1,45 +1,18 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <thread>
+#include <vector>
 #include <getopt.h>
 #include "data_structures.hpp"
 #include "mmu_pagers.hpp"
-
-void read_write_logic(Pager *THE_PAGER, Process *CURRENT_PROCESS, const int vpage, bool O)
-{
-    // Add Read/Write cycle cost to pager for accounting
-    THE_PAGER->allocate_cost(READ_WRITE);
-
-    if (!CURRENT_PROCESS->check_present_valid(vpage))
-    {
-        // Page fault logic
-        if (!CURRENT_PROCESS->vpage_can_be_accessed(vpage))
-        {
-            // Allocate cost of a segmentation violation
-            CURRENT_PROCESS->allocate_cost(SEGV);
-            if (O)
-            {
-                printf(" SEGV\n");
-            }
-            return;
-        }
-        else
-        {
-            // Page can be accessed, so it must be allocated
-            frame_t *frame = THE_PAGER->get_frame();
-
-            // See if the frame is coming from free frames or victim frames
-            if (frame->process_id != -1)
-            {
-                // Unmap Victim Frame
-                THE_PAGER->unmap_frame(frame->process_id, frame->VMA_page_number);
-            }
-
-            // Update referenced bit, frame number on VPage
-            THE_PAGER->map_frame(CURRENT_PROCESS, vpage, frame);
-        }
-    }
-}
+#include "trace_format.hpp"
+#include "trace_stream.hpp"
+#include "simulation.hpp"
+#include "sweep.hpp"
+#include "stack_distance.hpp"
+#include "event_sim.hpp"
+#include "structured_output.hpp"
 
 int main(int argc, char **argv)
 {
@@ -60,24 +33,32 @@ int main(int argc, char **argv)
     algorithms (not all algorithms have the details described in more detail below)
     -------------------------------------------------------------------------------
     */
-    bool O, P, F, S, x, y, a;
-    const char *optional_args;
+    bool O = false, P = false, F = false, S = false, x = false, y = false, a = false;
+    const char *optional_args = nullptr;
     int c;
-    unsigned int NUM_FRAMES;
+    unsigned int NUM_FRAMES = 0;
     char *char_sched_type = nullptr;
     std::string inputfile_name;
     std::string randfile_name;
-    std::string line;
+    const char *frame_arg = nullptr;
+    bool sweep = false;
+    bool miss_ratio_curve = false;
+    pager_options options = {{0, 0, true}, 0, false, {GLOBAL_REPLACEMENT, 0, 0, 0}, {0, 0, 0}, {NO_PREFETCH, 0}, {0, 3.0}};
+    des_config timing = {0, 0};
+    const char *structured_spec = nullptr;
+    const char *profile_spec = nullptr;
+    unsigned int num_threads = std::thread::hardware_concurrency();
     Pager *THE_PAGER;
     Process *process_arr = nullptr;
 
     // Arg parsing
-    while ((c = getopt(argc, argv, "f:a:o:xy")) != -1)
+    while ((c = getopt(argc, argv, "f:a:o:xysj:mt:H:bL:W:R:D:Z:J:M:")) != -1)
     {
         switch (c)
         {
         case 'f':
             NUM_FRAMES = atoi(optarg);
+            frame_arg = optarg;
             break;
         case 'a':
             char_sched_type = optarg;
@@ -87,6 +68,69 @@ int main(int argc, char **argv)
             optional_args = optarg;
             break;
 
+        // Sweep mode: -a / -f take lists, -j sets the worker thread count
+        case 's':
+            sweep = true;
+            break;
+        case 'j':
+            num_threads = atoi(optarg);
+            break;
+
+        // LRU miss ratio curve for every frame count from a single pass
+        case 'm':
+            miss_ratio_curve = true;
+            break;
+
+        // TLB model: entries[:ways[:flush]]
+        case 't':
+            options.tlb_geometry = parse_tlb_config(optarg);
+            break;
+
+        // Huge pages of 2^order base pages
+        case 'H':
+            options.huge_order = atoi(optarg);
+            break;
+
+        // Buddy allocator for free frames
+        case 'b':
+            options.buddy = true;
+            break;
+
+        // Local replacement with per process quotas: fixed[:quota] or pff[:low:high]
+        case 'L':
+            options.local = parse_local_config(optarg);
+            break;
+
+        // Background page cleaner: interval[:low:high]
+        case 'W':
+            options.writeback = parse_writeback_config(optarg);
+            break;
+
+        // Read-ahead: seq[:max_window], stride[:degree] or cluster[:pages]
+        case 'R':
+            options.prefetch = parse_prefetch_config(optarg);
+            break;
+
+        // Discrete-event timing mode: disk queue depth[:quantum]
+        case 'D':
+            timing = parse_des_config(optarg);
+            break;
+
+        // Compressed swap pool: percent of the frames[:mean compression ratio]
+        case 'Z':
+            options.zswap = parse_zswap_config(optarg);
+            break;
+
+        // Structured statistics: jsonl|csv[:interval[:file]]
+        case 'J':
+            structured_spec = optarg;
+            break;
+
+        // Fault profile (cost / re-fault histograms, page heatmap) at the end: jsonl|csv[:file]
+        case 'M':
+            profile_spec = optarg;
+            break;
+
         case '?':
             fprintf(stderr,
                     "usage: %s [dcs<size>]\n", argv[0]);
@@ -126,6 +170,12 @@ int main(int argc, char **argv)
         }
     }
 
+    // A single run needs a frame count the frame table can address (sweeps check their list)
+    if (!sweep && !miss_ratio_curve)
+    {
+        check_frame_count(NUM_FRAMES);
+    }
+
     // Grab input file name, random file name
     inputfile_name = argv[optind];
     randfile_name = argv[optind + 1];
@@ -150,185 +200,202 @@ int main(int argc, char **argv)
     }
     rfile.close();
 
-    // Initialize Pager Algorithm from Input
-    PAGER_TYPES pager_type = parse_pager_type_from_input(char_sched_type);
-    THE_PAGER = build_pager(pager_type, NUM_FRAMES, r_array_size, randvals, O, a);
-
-    // TODO: DELETE
-    // printf("Pager Algo (Enum): %d Pager Algo (Name): %s\n", THE_PAGER->ptype, GET_PAGER_NAME_FROM_ENUM(THE_PAGER->ptype));
-
-    // Helper Variables for Process / VMA Construction
-    std::ifstream input_file(inputfile_name);
-    unsigned int num_processes = 0;
-    unsigned int vma_lines_to_read = 0;
-    int process_read_count = 0;
-    unsigned int start_vpage = 0;
-    unsigned int end_vpage = 0;
-    unsigned int write_protected = 0;
-    unsigned int file_mapped = 0;
-
-    // Read in input from file -> Read in Num Process -> Make VMAs
-    while (getline(input_file, line))
+    if (miss_ratio_curve)
     {
-        // Ignore line comments
-        if (line.c_str()[0] != '#')
+        unsigned int num_processes = 0;
+        if (is_binary_trace(inputfile_name))
         {
-            // Get num processes (Only Once)
-            if (!num_processes)
+            MappedTrace binary_trace(inputfile_name);
+            num_processes = binary_trace.get_num_processes();
+            process_arr = binary_trace.build_processes();
+            StackDistanceAnalyzer analyzer(process_arr, num_processes);
+            for (const trace_record *record = binary_trace.begin(); record != binary_trace.end(); record++)
             {
-                // Read in number of processes
-                sscanf(line.c_str(), "%d", &num_processes);
-
-                // Initiliaze Process Array
-                process_arr = new Process[num_processes];
+                analyzer.process_instruction((char)record->op, (int)record->arg);
             }
-            else if (process_read_count < num_processes)
+            analyzer.print_miss_ratio_curve();
+        }
+        else
+        {
+            TraceTokenizer text_trace(inputfile_name);
+            process_arr = text_trace.read_processes(num_processes);
+            StackDistanceAnalyzer analyzer(process_arr, num_processes);
+            char operation;
+            int vpage = 0;
+            while (text_trace.next_instruction(operation, vpage))
+            {
+                analyzer.process_instruction(operation, vpage);
+            }
+            analyzer.print_miss_ratio_curve();
+        }
+        return 0;
+    }
+
+    if (sweep)
+    {
+        // Every (pager, frame count) pair, in the order given on the command line
+        std::vector<sweep_config> configs;
+        std::vector<PAGER_TYPES> pagers = parse_pager_list(char_sched_type ? char_sched_type : "f,r,c,e,a,w,l,arc,car,lirs,clockpro");
+        std::vector<unsigned int> frame_counts = parse_frame_list(frame_arg ? frame_arg : "1-" + std::to_string(MAX_FRAMES));
+        for (size_t p = 0; p < pagers.size(); p++)
+        {
+            for (size_t f = 0; f < frame_counts.size(); f++)
             {
-                // Get how many lines of VMAs are present for process
-                sscanf(line.c_str(), "%d", &vma_lines_to_read);
-                process_arr[process_read_count].init_vma(vma_lines_to_read);
-                // Read in however many VMA lines there are
-                for (int vma_num = 0; vma_num < vma_lines_to_read; vma_num++)
-                {
-                    // Get the next line which Contains VMA specs
-                    getline(input_file, line);
-
-                    // Read in VMA Specifications
-                    sscanf(line.c_str(), "%d %d %d %d", &start_vpage, &end_vpage, &write_protected, &file_mapped);
-
-                    // Access Process Array and Set the VMA specs in the correct Process's page table
-                    process_arr[process_read_count].add_vma(vma_num, start_vpage, end_vpage, write_protected, file_mapped);
-                }
-                process_read_count++;
+                sweep_config config = {pagers[p], frame_counts[f]};
+                configs.push_back(config);
             }
-            else
+        }
+
+        // Load the trace once, shared read only by all configurations
+        unsigned int num_processes = 0;
+        std::vector<trace_record> records;
+        const trace_record *records_begin;
+        const trace_record *records_end;
+        MappedTrace *binary_trace = nullptr;
+        if (is_binary_trace(inputfile_name))
+        {
+            binary_trace = new MappedTrace(inputfile_name);
+            num_processes = binary_trace->get_num_processes();
+            process_arr = binary_trace->build_processes();
+            records_begin = binary_trace->begin();
+            records_end = binary_trace->end();
+        }
+        else
+        {
+            TraceTokenizer text_trace(inputfile_name);
+            process_arr = text_trace.read_processes(num_processes);
+            char operation;
+            int vpage = 0;
+            while (text_trace.next_instruction(operation, vpage))
             {
-                break;
+                trace_record record;
+                record.op = (unsigned char)operation;
+                record.arg = vpage;
+                records.push_back(record);
             }
+            records_begin = records.data();
+            records_end = records.data() + records.size();
         }
+
+        SweepEngine engine(configs, records_begin, records_end, process_arr, num_processes, r_array_size, randvals, options);
+        engine.run(num_threads);
+        delete binary_trace;
+        return 0;
+    }
+
+    // Initialize Pager Algorithm from Input
+    PAGER_TYPES pager_type = parse_pager_type_from_input(char_sched_type);
+    THE_PAGER = build_configured_pager(pager_type, NUM_FRAMES, r_array_size, randvals, O, a, options);
+
+    // TODO: DELETE
+    // printf("Pager Algo (Enum): %d Pager Algo (Name): %s\n", THE_PAGER->ptype, GET_PAGER_NAME_FROM_ENUM(THE_PAGER->ptype));
+
+    // Binary traces are memory mapped and replayed without any text parsing
+    MappedTrace *binary_trace = nullptr;
+    TraceTokenizer *text_trace = nullptr;
+    unsigned int num_processes = 0;
+    if (is_binary_trace(inputfile_name))
+    {
+        binary_trace = new MappedTrace(inputfile_name);
+        num_processes = binary_trace->get_num_processes();
+        process_arr = binary_trace->build_processes();
+    }
+    else
+    {
+        // Text input (file, pipe or "-" for stdin) is parsed in a single forward pass
+        text_trace = new TraceTokenizer(inputfile_name);
+        process_arr = text_trace->read_processes(num_processes);
     }
-    input_file.close();
 
     // Add process arr to pointer for easier accounting
     THE_PAGER->init_process_metadata(num_processes, process_arr);
+    if (profile_spec)
+    {
+        THE_PAGER->attach_profiler(new FaultProfiler(process_arr, num_processes));
+    }
 
     // ####################################
     // ######## Simulation Begins #########
     // ###################################
 
     // Helper variables for simulation
-    char operation;
-    int vpage;
-    int current_process_num;
-    int inst_count = 0;
-    Process *CURRENT_PROCESS;
-    input_file.open(inputfile_name);
-
-    // Read instructions
-    while (getline(input_file, line))
+    sim_state state;
+    state.THE_PAGER = THE_PAGER;
+    state.process_arr = process_arr;
+    state.CURRENT_PROCESS = nullptr;
+    state.current_process_num = 0;
+    state.inst_count = 0;
+
+    // JSON Lines / CSV statistics, with a time series every interval instructions
+    StructuredWriter *structured = nullptr;
+    bool structured_stdout = false;
+    if (structured_spec)
     {
-        // Ignore line comments
-        if (line.c_str()[0] != '#')
-        {
-            // Parse Operation + Vpage from input
-            sscanf(line.c_str(), "%s %d", &operation, &vpage);
+        structured_config config = parse_structured_config(structured_spec);
+        structured_stdout = config.file_name == "-";
+        structured = new StructuredWriter(config);
+    }
+    state.output = structured;
 
-            // If O option print instruction details
-            if ((operation == 'c' || operation == 'w' || operation == 'e' || operation == 'r'))
-            {
-                if (O)
-                {
-                    printf("%d: ==> %s %d\n", inst_count, &operation, vpage);
-                }
-                inst_count++;
-            }
+    // The O output is formatted by a background thread unless other output is interleaved with it
+    if (O && !TraceSink::enabled)
+    {
+        fprintf(stderr, "Built with NO_TRACE, the O option prints nothing\n");
+    }
+    if (O && !a && !structured_stdout)
+    {
+        THE_PAGER->start_async_tracing();
+    }
 
-            switch (operation)
-            {
-            case 'c':
-                // Update current process number
-                current_process_num = vpage;
-                // Add context-switching cycle cost to pager for accounting
-                THE_PAGER->allocate_cost(CONTEXT_SWITCH);
-                // Update the pointer to current Process
-                CURRENT_PROCESS = &process_arr[current_process_num];
-                break;
+    // The timing mode schedules processes itself, so it needs the whole trace up front
+    EventSimulation *event_sim = nullptr;
+    if (timing.queue_depth)
+    {
+        event_sim = new EventSimulation(&state, num_processes, timing);
+    }
 
-            case 'e':
-                // Add Process-Exit cycle cost to pager for accounting
-                THE_PAGER->allocate_cost(PROC_EXIT);
-                if (O)
-                {
-                    printf("EXIT current process %d\n", current_process_num);
-                }
-
-                // Traverse active process page table, each valid entry unmap the page
-                for (int i = 0; i < NUM_PTE; i++)
-                {
-                    pte_t *temp = CURRENT_PROCESS->get_vpage(i);
-                    if (temp->PRESENT)
-                    {
-
-                        if (O)
-                        {
-                            printf(" UNMAP %d:%d\n", current_process_num, i);
-                            if (temp->FILEMAPPED && temp->MODIFIED)
-                            {
-                                printf(" FOUT\n");
-                            }
-                        }
-
-                        // Unmap frame
-                        unsigned int frame_num = temp->frame_number;
-                        THE_PAGER->clear_mapping(frame_num);
-
-                        // Add frame to free list
-                        THE_PAGER->add_frame_to_free_list(frame_num);
-
-                        // Update accounting per instructions:
-                        /*On process exit (instruction), you have to traverse the active process’s pagetable starting from
-                         0..63 and for each valid entry UNMAP the page and FOUT modified filemapped pages.
-                        Note that dirty non-fmapped (anonymous) pages are not written back (OUT) as the process exits.*/
-                        CURRENT_PROCESS->allocate_cost(UNMAPS);
-                        if (temp->FILEMAPPED && temp->MODIFIED)
-                        {
-                            CURRENT_PROCESS->allocate_cost(FOUTS);
-                        }
-                    }
-                    // Reset all pte_t bits to 0
-                    CURRENT_PROCESS->set_all_to_zero(temp);
-                }
-                break;
-            case 'r':
-                // Read instruction logic
-                read_write_logic(THE_PAGER, CURRENT_PROCESS, vpage, O);
-                CURRENT_PROCESS->set_referenced(vpage);
-                break;
-            case 'w':
-                // Write instruction logic
-                read_write_logic(THE_PAGER, CURRENT_PROCESS, vpage, O);
-
-                // Check if write protect is enabled, if so raise SEGPROT
-                if (CURRENT_PROCESS->write_protect_enabled(vpage))
-                {
-                    // Then we raise a SEGPROT error as we cannot write to this VMA
-                    CURRENT_PROCESS->allocate_cost(SEGPROT);
-                    printf(" SEGPROT\n");
-                }
-                else
-                {
-                    // Update Modified if written to successfully
-                    CURRENT_PROCESS->set_write(vpage);
-                }
-
-                // Update ref bit
-                CURRENT_PROCESS->set_referenced(vpage);
-                break;
-            }
+    if (event_sim && binary_trace)
+    {
+        event_sim->run(binary_trace->begin(), binary_trace->end());
+        delete binary_trace;
+    }
+    else if (event_sim)
+    {
+        std::vector<trace_record> records;
+        char operation;
+        int vpage = 0;
+        while (text_trace->next_instruction(operation, vpage))
+        {
+            trace_record record;
+            record.op = (unsigned char)operation;
+            record.arg = vpage;
+            records.push_back(record);
         }
+        delete text_trace;
+        event_sim->run(records.data(), records.data() + records.size());
+    }
+    else if (binary_trace)
+    {
+        // Records feed the instruction logic directly
+        for (const trace_record *record = binary_trace->begin(); record != binary_trace->end(); record++)
+        {
+            execute_instruction(&state, (char)record->op, (int)record->arg);
+        }
+        delete binary_trace;
+    }
+    else
+    {
+        // Continue from where the header left off
+        char operation;
+        int vpage = 0;
+        while (text_trace->next_instruction(operation, vpage))
+        {
+            execute_instruction(&state, operation, vpage);
+        }
+        delete text_trace;
     }
-    input_file.close();
 
+    THE_PAGER->finish_tracing();
     if (P)
     {
         THE_PAGER->print_process_ptes();
@@ -342,6 +409,21 @@ int main(int argc, char **argv)
         THE_PAGER->print_per_process_stats();
         THE_PAGER->print_total_cost();
     }
+    if (event_sim)
+    {
+        event_sim->print_stats();
+        delete event_sim;
+    }
+    if (structured)
+    {
+        THE_PAGER->write_structured_stats(*structured);
+        delete structured;
+    }
+    if (profile_spec)
+    {
+        StructuredWriter profile(parse_profile_config(profile_spec));
+        THE_PAGER->get_profiler()->write(profile);
+    }
 
     return 0;
 }
\ No newline at end of file
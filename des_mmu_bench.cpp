@@ -0,0 +1,314 @@
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "data_structures.hpp"
+#include "mmu_pagers.hpp"
+#include "trace_format.hpp"
+#include "trace_stream.hpp"
+#include "simulation.hpp"
+#include "sweep.hpp"
+#include "workload.hpp"
+
+/* Throughput benchmarks (make bench):
+   - BM_SelectVictim/<pager>/<frames>: the replacement path of every pager with
+     all frames in use, a hit on a resident page plus a fault on the next page
+     (select_victim_frame + unmap_frame + map_frame) per iteration
+   - BM_MapUnmap: map_frame / unmap_frame on their own
+   - BM_GetVpage/<pages>: page table lookups, touched pages spread over the address space
+   - BM_ParseInstructions: text trace tokenizer, instructions per second
+   - BM_Replay/<model>/<pager>/<frames>: end to end replay of a synthetic trace
+   Rates are reported as items_per_second (instructions or faults per second),
+   the replacement path also as time/fault. */
+
+const unsigned int BENCH_PROCESSES = 4;
+const uint64_t BENCH_INSTRUCTIONS = 200000;
+const int BENCH_RANDVALS = 40000;
+
+const PAGER_TYPES BENCH_PAGERS[] = {FIFO, Random, Clock, ESC_NRU, Aging, Working_Set, LRU, ARC, CAR, LIRS, CLOCK_Pro};
+
+workload_config bench_workload(WORKLOAD_MODELS model)
+{
+    workload_config config = default_workload_config();
+    workload_phase phase = {model, model == ZIPF_WORKLOAD ? 0.99 : model == STRIDE_WORKLOAD ? 4.0 : NUM_PTE / 2};
+    config.phases.assign(1, phase);
+    config.num_processes = BENCH_PROCESSES;
+    config.num_instructions = BENCH_INSTRUCTIONS;
+    return config;
+}
+
+// Every Process needs the pid of its index, pids come from a global counter.
+// The template array is built once before any other Process and cloned afterwards.
+Process *build_template_processes()
+{
+    std::vector<uint32_t> vma_counts;
+    std::vector<trace_vma_spec> vmas;
+    WorkloadGenerator generator(bench_workload(UNIFORM_WORKLOAD));
+    unsigned int num_processes = generator.header(vma_counts, vmas);
+    return build_process_arr(num_processes, vma_counts.data(), vmas.data());
+}
+Process *template_processes = build_template_processes();
+
+std::vector<int> build_randvals()
+{
+    std::vector<int> randvals(BENCH_RANDVALS);
+    WorkloadRng rng(7);
+    for (int i = 0; i < BENCH_RANDVALS; i++)
+    {
+        randvals[i] = (int)rng.below(1u << 30);
+    }
+    return randvals;
+}
+std::vector<int> bench_randvals = build_randvals();
+
+Pager *build_bench_pager(PAGER_TYPES pager_type, unsigned int num_frames, Process *processes)
+{
+    pager_options options = {{0, 0, true}, 0, false, {GLOBAL_REPLACEMENT, 0, 0, 0}, {0, 0, 0}, {NO_PREFETCH, 0}, {0, 3.0}};
+    Pager *pager = build_configured_pager(pager_type, num_frames, BENCH_RANDVALS, bench_randvals.data(), false, false, options);
+    pager->init_process_metadata(BENCH_PROCESSES, processes);
+    return pager;
+}
+
+// A reference to a resident page the way execute_instruction handles a read hit
+inline void touch(Pager *pager, Process *process, int vpage)
+{
+    process->set_referenced(vpage);
+    if (pager->tracks_references)
+    {
+        pager->reference_frame(process->get_frame_num(vpage));
+    }
+    if (pager->mirrors_rm_bits)
+    {
+        pager->sync_rm_bits(process, vpage);
+    }
+}
+
+static void BM_SelectVictim(benchmark::State &state, PAGER_TYPES pager_type)
+{
+    unsigned int num_frames = state.range(0);
+    Process *processes = clone_process_arr(template_processes, BENCH_PROCESSES);
+    Pager *pager = build_bench_pager(pager_type, num_frames, processes);
+
+    // Pages are (pid, vpage) pairs, the first num_frames of them fill memory
+    std::vector<int> frame_page(num_frames);
+    unsigned int total_pages = BENCH_PROCESSES * NUM_PTE;
+    for (unsigned int page = 0; page < num_frames; page++)
+    {
+        Process *process = &processes[page % BENCH_PROCESSES];
+        int vpage = page / BENCH_PROCESSES;
+        process->vpage_can_be_accessed(vpage);
+        pager->page_fault(process, vpage);
+        frame_t *frame = pager->get_frame(process, vpage);
+        pager->map_frame(process, vpage, frame);
+        frame_page[frame->frame_number] = page;
+    }
+
+    // Each iteration: a hit on a random resident page, then a fault on the next
+    // non resident page, which takes the place of the victim
+    WorkloadRng rng(1);
+    unsigned int next_page = num_frames % total_pages;
+    uint64_t faults = 0;
+    for (auto _ : state)
+    {
+        int hit = frame_page[rng.below(num_frames)];
+        touch(pager, &processes[hit % BENCH_PROCESSES], hit / BENCH_PROCESSES);
+
+        Process *process = &processes[next_page % BENCH_PROCESSES];
+        int vpage = next_page / BENCH_PROCESSES;
+        if (!process->check_present_valid(vpage))
+        {
+            process->vpage_can_be_accessed(vpage);
+            pager->allocate_cost(READ_WRITE);
+            pager->page_fault(process, vpage);
+            frame_t *victim = pager->select_victim_frame();
+            pager->unmap_frame(victim->process_id, victim->VMA_page_number);
+            pager->map_frame(process, vpage, victim);
+            frame_page[victim->frame_number] = next_page;
+            faults++;
+        }
+        next_page = next_page + 1 < total_pages ? next_page + 1 : 0;
+    }
+    state.SetItemsProcessed(faults);
+    state.counters["time/fault"] = benchmark::Counter(faults, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+
+    delete pager;
+    delete[] processes;
+}
+
+static void BM_MapUnmap(benchmark::State &state)
+{
+    Process *processes = clone_process_arr(template_processes, BENCH_PROCESSES);
+    Pager *pager = build_bench_pager(FIFO, 1, processes);
+    Process *process = &processes[0];
+    frame_t *frame = pager->get_frame(process, 0);
+    int vpage = 0;
+    for (auto _ : state)
+    {
+        process->vpage_can_be_accessed(vpage);
+        pager->map_frame(process, vpage, frame);
+        pager->unmap_frame(0, vpage);
+        vpage = vpage + 1 < (int)NUM_PTE ? vpage + 1 : 0;
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    delete pager;
+    delete[] processes;
+}
+
+static void BM_GetVpage(benchmark::State &state)
+{
+    unsigned int touched = state.range(0);
+    Process *processes = clone_process_arr(template_processes, BENCH_PROCESSES);
+    Process *process = &processes[0];
+
+    // Touched pages are spread evenly, so multi level tables get several leaves
+    std::vector<int> vpages;
+    WorkloadRng rng(3);
+    unsigned int step = std::max(1u, NUM_PTE / touched);
+    for (unsigned int vpage = 0; vpage < NUM_PTE && vpages.size() < touched; vpage += step)
+    {
+        process->get_vpage(vpage);
+        vpages.push_back(vpage);
+    }
+    std::vector<int> order(4096);
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = vpages[rng.below(vpages.size())];
+    }
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(process->get_vpage(order[i]));
+        i = (i + 1) & (order.size() - 1);
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    delete[] processes;
+}
+
+// Writes a synthetic trace as a des_mmu text input
+void write_text_trace(const std::string &file_name, const workload_config &config)
+{
+    WorkloadGenerator generator(config);
+    std::vector<uint32_t> vma_counts;
+    std::vector<trace_vma_spec> vmas;
+    generator.header(vma_counts, vmas);
+    TextTraceWriter writer(file_name, vma_counts, vmas);
+    char operation;
+    int arg;
+    while (generator.next(operation, arg))
+    {
+        writer.add_record(operation, arg);
+    }
+    writer.finish();
+}
+
+static void BM_ParseInstructions(benchmark::State &state)
+{
+    char file_name[] = "/tmp/des_mmu_bench_XXXXXX";
+    int fd = mkstemp(file_name);
+    close(fd);
+    write_text_trace(file_name, bench_workload(ZIPF_WORKLOAD));
+
+    uint64_t instructions = 0;
+    for (auto _ : state)
+    {
+        TraceTokenizer tokenizer(file_name);
+        unsigned int num_processes = 0;
+        Process *processes = tokenizer.read_processes(num_processes);
+        char operation;
+        int arg = 0;
+        while (tokenizer.next_instruction(operation, arg))
+        {
+            benchmark::DoNotOptimize(arg);
+            instructions++;
+        }
+        state.PauseTiming();
+        delete[] processes;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(instructions);
+    unlink(file_name);
+}
+
+static void BM_Replay(benchmark::State &state, WORKLOAD_MODELS model, PAGER_TYPES pager_type)
+{
+    unsigned int num_frames = state.range(0);
+    std::vector<trace_record> records;
+    WorkloadGenerator generator(bench_workload(model));
+    char operation;
+    int arg;
+    while (generator.next(operation, arg))
+    {
+        trace_record record;
+        record.op = (unsigned char)operation;
+        record.arg = arg;
+        records.push_back(record);
+    }
+
+    uint64_t faults = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        Process *processes = clone_process_arr(template_processes, BENCH_PROCESSES);
+        Pager *pager = build_bench_pager(pager_type, num_frames, processes);
+        sim_state sim;
+        sim.THE_PAGER = pager;
+        sim.process_arr = processes;
+        sim.CURRENT_PROCESS = nullptr;
+        sim.current_process_num = 0;
+        sim.inst_count = 0;
+        sim.output = nullptr;
+        state.ResumeTiming();
+
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            execute_instruction(&sim, (char)records[i].op, (int)records[i].arg);
+        }
+
+        state.PauseTiming();
+        for (unsigned int i = 0; i < BENCH_PROCESSES; i++)
+        {
+            faults += processes[i].get_count(MAPS);
+        }
+        delete pager;
+        delete[] processes;
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * records.size());
+    state.counters["time/fault"] = benchmark::Counter(faults, benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+int main(int argc, char **argv)
+{
+    for (size_t p = 0; p < sizeof(BENCH_PAGERS) / sizeof(BENCH_PAGERS[0]); p++)
+    {
+        std::string name = std::string("BM_SelectVictim/") + GET_PAGER_NAME_FROM_ENUM(BENCH_PAGERS[p]);
+        benchmark::RegisterBenchmark(name.c_str(), BM_SelectVictim, BENCH_PAGERS[p])->Arg(16)->Arg(MAX_FRAMES);
+    }
+    benchmark::RegisterBenchmark("BM_MapUnmap", BM_MapUnmap);
+    benchmark::RegisterBenchmark("BM_GetVpage", BM_GetVpage)->Arg(8)->Arg(NUM_PTE);
+    benchmark::RegisterBenchmark("BM_ParseInstructions", BM_ParseInstructions)->Unit(benchmark::kMillisecond);
+    for (int model = UNIFORM_WORKLOAD; model <= LOOP_WORKLOAD; model++)
+    {
+        for (size_t p = 0; p < sizeof(BENCH_PAGERS) / sizeof(BENCH_PAGERS[0]); p++)
+        {
+            std::string name = std::string("BM_Replay/") + WORKLOAD_MODEL_NAMES[model] + "/" + GET_PAGER_NAME_FROM_ENUM(BENCH_PAGERS[p]);
+            benchmark::RegisterBenchmark(name.c_str(), BM_Replay, (WORKLOAD_MODELS)model, BENCH_PAGERS[p])
+                ->Arg(NUM_PTE)
+                ->Unit(benchmark::kMillisecond);
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,395 @@
+#include "data_structures.hpp"
+#include "mmu_pagers.hpp"
+#include "simulation.hpp"
+#include "trace_format.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef EVENT_SIM
+#define EVENT_SIM
+
+// Discrete-event timing mode, queue_depth == 0 means off
+typedef struct des_config
+{
+    // Disk requests in service at once
+    unsigned int queue_depth;
+    // Instructions per time slice, 0 = a process runs until it blocks or exits
+    unsigned int quantum;
+} des_config;
+
+// Parses "depth[:quantum]"
+des_config parse_des_config(const std::string &spec)
+{
+    des_config config = {0, 0};
+    int n = sscanf(spec.c_str(), "%u:%u", &config.queue_depth, &config.quantum);
+    if (n < 1 || config.queue_depth == 0)
+    {
+        throw std::invalid_argument("Invalid timing config (depth[:quantum]): " + spec);
+    }
+    return config;
+}
+
+/* Discrete-event replay of a trace on one CPU and one disk.
+   The trace is split into per process instruction streams ('c' lines only
+   tell which process an instruction belongs to), every process is runnable
+   at time 0 and a round robin scheduler decides the interleaving.
+
+   An instruction runs through execute_instruction like in the regular mode.
+   Its CPU time is the flat cost of everything it did except for I/O. Reads
+   and writes it had to wait for (IN / FIN, plus OUT / FOUT of its victim)
+   become a chain of disk requests: the process blocks until the last one
+   completes and the CPU switches to another runnable process. Background
+   write back and read-ahead requests occupy the disk without blocking
+   anybody. The disk serves up to queue_depth requests at once, each taking
+   the flat cost of its operation, the rest wait in FIFO order. */
+class EventSimulation
+{
+public:
+    EventSimulation(sim_state *state_, unsigned int num_processes_, const des_config &config_)
+    {
+        state = state_;
+        num_processes = num_processes_;
+        config = config_;
+        procs.assign(num_processes, proc_state());
+    }
+
+    void run(const trace_record *begin, const trace_record *end)
+    {
+        // Split the trace into per process streams, first appearance sets the initial run queue order
+        int pid = -1;
+        for (const trace_record *record = begin; record != end; record++)
+        {
+            if ((char)record->op == 'c')
+            {
+                pid = (int)record->arg;
+                // Only the first one counts, the same pid can be switched to again before its first access
+                if (!procs[pid].queued)
+                {
+                    procs[pid].queued = true;
+                    run_queue.push_back(pid);
+                }
+            }
+            else if (pid >= 0)
+            {
+                procs[pid].stream.push_back(*record);
+                // Forked processes become runnable at their fork
+                if ((char)record->op == 'f')
+                {
+                    procs[record->arg].forked = true;
+                }
+            }
+        }
+        for (size_t i = 0; i < run_queue.size();)
+        {
+            if (procs[run_queue[i]].forked)
+            {
+                run_queue.erase(run_queue.begin() + i);
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        int running = -1;
+        int last_running = -1;
+        unsigned int slice = 0;
+        while (true)
+        {
+            if (running < 0)
+            {
+                if (!run_queue.empty())
+                {
+                    running = run_queue.front();
+                    run_queue.pop_front();
+                    slice = 0;
+                    if (running != last_running)
+                    {
+                        step(running, 'c', running);
+                        last_running = running;
+                    }
+                    continue;
+                }
+                if (!events.empty())
+                {
+                    // CPU idles until the next I/O completes
+                    now = std::max(now, events.top().time);
+                    complete_next();
+                    continue;
+                }
+                break;
+            }
+
+            // Completions that happened while the CPU was busy
+            while (!events.empty() && events.top().time <= now)
+            {
+                complete_next();
+            }
+
+            proc_state &proc = procs[running];
+            if (proc.next == proc.stream.size())
+            {
+                // Stream ended without an exit
+                proc.done = true;
+                proc.finish = now;
+                running = -1;
+                continue;
+            }
+            char operation = (char)proc.stream[proc.next].op;
+            int arg = (int)proc.stream[proc.next].arg;
+            proc.next++;
+            step(running, operation, arg);
+            if (operation == 'f' && !procs[arg].stream.empty())
+            {
+                run_queue.push_back(arg);
+            }
+
+            if (operation == 'e' || proc.next == proc.stream.size())
+            {
+                proc.done = true;
+                proc.finish = now;
+            }
+            if (!proc.chain.empty())
+            {
+                proc.blocked_since = now;
+                submit(proc.chain.front(), running, now);
+                running = -1;
+            }
+            else if (proc.done)
+            {
+                running = -1;
+            }
+            else if (config.quantum && ++slice >= config.quantum)
+            {
+                run_queue.push_back(running);
+                running = -1;
+            }
+        }
+        makespan = now;
+    }
+
+    // Makespan, CPU / disk utilization, then fault latency percentiles per process
+    void print_stats(FILE *out = stdout)
+    {
+        double cpu_util = makespan ? 100.0 * cpu_busy / makespan : 0.0;
+        double disk_util = makespan ? 100.0 * disk_busy / ((double)makespan * config.queue_depth) : 0.0;
+        double avg_wait = disk_requests ? (double)queue_wait / disk_requests : 0.0;
+        fprintf(out, "DES makespan=%llu cpu=%.2f%% disk=%.2f%% ios=%lu qwait=%.1f\n",
+                (unsigned long long)makespan, cpu_util, disk_util, disk_requests, avg_wait);
+        for (unsigned int i = 0; i < num_processes; i++)
+        {
+            std::vector<uint64_t> &lat = procs[i].latencies;
+            std::sort(lat.begin(), lat.end());
+            fprintf(out, "DES[%u]: finish=%llu blocked=%lu p50=%llu p90=%llu p99=%llu max=%llu\n", i,
+                    (unsigned long long)procs[i].finish, (unsigned long)lat.size(),
+                    (unsigned long long)percentile(lat, 50), (unsigned long long)percentile(lat, 90),
+                    (unsigned long long)percentile(lat, 99), (unsigned long long)(lat.empty() ? 0 : lat.back()));
+        }
+    }
+
+private:
+    static const int NUM_SYNC_IO = 4;
+    static const int NUM_ASYNC_IO = 4;
+    const PROC_CYCLES SYNC_IO[NUM_SYNC_IO] = {OUTS, FOUTS, INS, FINS};
+    const uint64_t SYNC_IO_COST[NUM_SYNC_IO] = {int_outs, int_fouts, int_ins, int_fins};
+    const PROC_CYCLES ASYNC_IO[NUM_ASYNC_IO] = {BG_OUTS, BG_FOUTS, RA_INS, RA_FINS};
+    const uint64_t ASYNC_IO_COST[NUM_ASYNC_IO] = {int_outs, int_fouts, int_ins, int_fins};
+
+    typedef struct cost_snapshot
+    {
+        unsigned long long total;
+        unsigned long sync_io[NUM_SYNC_IO];
+        unsigned long async_io[NUM_ASYNC_IO];
+    } cost_snapshot;
+
+    typedef struct io_request
+    {
+        uint64_t service;
+        // Blocked process waiting for it, -1 for background I/O
+        int pid;
+        uint64_t submitted;
+    } io_request;
+
+    typedef struct io_event
+    {
+        uint64_t time;
+        // Submission order breaks ties
+        uint64_t seq;
+        io_request request;
+        bool operator>(const io_event &other) const
+        {
+            return time != other.time ? time > other.time : seq > other.seq;
+        }
+    } io_event;
+
+    typedef struct proc_state
+    {
+        std::vector<trace_record> stream;
+        size_t next = 0;
+        // Service times of the blocking requests still to go, the front one is submitted
+        std::deque<uint64_t> chain;
+        uint64_t blocked_since = 0;
+        std::vector<uint64_t> latencies;
+        uint64_t finish = 0;
+        bool done = false;
+        bool forked = false;
+        // Already placed in the initial run queue
+        bool queued = false;
+    } proc_state;
+
+    sim_state *state;
+    unsigned int num_processes;
+    des_config config;
+    std::vector<proc_state> procs;
+    std::deque<int> run_queue;
+
+    uint64_t now = 0;
+    uint64_t makespan = 0;
+    uint64_t cpu_busy = 0;
+
+    // Disk: completion events of requests in service, FIFO of waiting ones
+    std::priority_queue<io_event, std::vector<io_event>, std::greater<io_event> > events;
+    std::deque<io_request> disk_queue;
+    unsigned int in_service = 0;
+    uint64_t event_seq = 0;
+    uint64_t disk_busy = 0;
+    uint64_t queue_wait = 0;
+    unsigned long disk_requests = 0;
+
+    // Runs one instruction of pid at the current time: advances the clock by its CPU
+    // time, submits its background I/O and queues the I/O it must wait for on its chain
+    void step(int pid, char operation, int arg)
+    {
+        cost_snapshot before = snapshot();
+        execute_instruction(state, operation, arg);
+        cost_snapshot after = snapshot();
+
+        // CPU time: the instruction itself plus all non I/O work it caused
+        uint64_t io_cycles = 0;
+        for (int i = 0; i < NUM_SYNC_IO; i++)
+        {
+            io_cycles += (after.sync_io[i] - before.sync_io[i]) * SYNC_IO_COST[i];
+        }
+        // Annotations ('z') take no time
+        uint64_t cpu = operation == 'c' ? CONTEXT_SWITCH : operation == 'e' ? PROC_EXIT : operation == 'f' ? FORK : operation == 'z' ? 0 : READ_WRITE;
+        cpu += (after.total - before.total) - io_cycles;
+        now += cpu;
+        cpu_busy += cpu;
+
+        // Asynchronous I/O doesn't block anybody
+        for (int i = 0; i < NUM_ASYNC_IO; i++)
+        {
+            for (unsigned long n = before.async_io[i]; n < after.async_io[i]; n++)
+            {
+                submit(ASYNC_IO_COST[i], -1, now);
+            }
+        }
+
+        // Synchronous I/O in order: victim write back first, then the read
+        for (int i = 0; i < NUM_SYNC_IO; i++)
+        {
+            for (unsigned long n = before.sync_io[i]; n < after.sync_io[i]; n++)
+            {
+                procs[pid].chain.push_back(SYNC_IO_COST[i]);
+            }
+        }
+    }
+
+    cost_snapshot snapshot()
+    {
+        cost_snapshot snap = {};
+        for (unsigned int i = 0; i < num_processes; i++)
+        {
+            Process &process = state->process_arr[i];
+            snap.total += process.calc_total_cost();
+            for (int k = 0; k < NUM_SYNC_IO; k++)
+            {
+                snap.sync_io[k] += process.get_count(SYNC_IO[k]);
+            }
+            for (int k = 0; k < NUM_ASYNC_IO; k++)
+            {
+                snap.async_io[k] += process.get_count(ASYNC_IO[k]);
+            }
+        }
+        return snap;
+    }
+
+    void submit(uint64_t service, int pid, uint64_t time)
+    {
+        io_request request = {service, pid, time};
+        disk_requests++;
+        if (in_service < config.queue_depth)
+        {
+            start(request, time);
+        }
+        else
+        {
+            disk_queue.push_back(request);
+        }
+    }
+
+    void start(const io_request &request, uint64_t time)
+    {
+        in_service++;
+        disk_busy += request.service;
+        queue_wait += time - request.submitted;
+        io_event event = {time + request.service, event_seq++, request};
+        events.push(event);
+    }
+
+    // Retires the earliest completion: frees its disk slot, then advances or wakes its process
+    void complete_next()
+    {
+        io_event event = events.top();
+        events.pop();
+        in_service--;
+        if (!disk_queue.empty())
+        {
+            start(disk_queue.front(), event.time);
+            disk_queue.pop_front();
+        }
+        now = std::max(now, event.time);
+
+        int pid = event.request.pid;
+        if (pid < 0)
+        {
+            return;
+        }
+        proc_state &proc = procs[pid];
+        proc.chain.pop_front();
+        if (!proc.chain.empty())
+        {
+            submit(proc.chain.front(), pid, event.time);
+            return;
+        }
+        proc.latencies.push_back(event.time - proc.blocked_since);
+        if (proc.done)
+        {
+            proc.finish = event.time;
+        }
+        else
+        {
+            run_queue.push_back(pid);
+        }
+    }
+
+    // Nearest rank percentile of a sorted sample
+    static uint64_t percentile(const std::vector<uint64_t> &sorted, unsigned int p)
+    {
+        if (sorted.empty())
+        {
+            return 0;
+        }
+        size_t rank = (sorted.size() * p + 99) / 100;
+        return sorted[rank ? rank - 1 : 0];
+    }
+};
+
+#endif
@@ -0,0 +1,321 @@
+#include "data_structures.hpp"
+#include "structured_output.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef FAULT_PROFILE
+#define FAULT_PROFILE
+
+// Parses "jsonl|csv[:file]", the fault profile is written once at the end of the run
+structured_config parse_profile_config(const std::string &spec)
+{
+    size_t colon = spec.find(':');
+    structured_config config = parse_structured_config(spec.substr(0, colon));
+    if (colon != std::string::npos && colon + 1 < spec.size())
+    {
+        config.file_name = spec.substr(colon + 1);
+    }
+    return config;
+}
+
+/* HDR style histogram: exact below 2^SUB_BITS, above that every power of two
+   range is split into 2^SUB_BITS equal buckets, so any recorded value is off
+   by less than 1 / 2^SUB_BITS (~6%) while the whole 64 bit range fits in
+   about a thousand counters. */
+class LogHistogram
+{
+public:
+    static const int SUB_BITS = 4;
+    static const uint64_t SUB_BUCKETS = 1 << SUB_BITS;
+
+    LogHistogram() : buckets((64 - SUB_BITS + 1) * SUB_BUCKETS, 0) {}
+
+    void record(uint64_t value)
+    {
+        buckets[bucket_of(value)]++;
+        count++;
+        sum += value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+
+    uint64_t get_count() const
+    {
+        return count;
+    }
+
+    uint64_t get_min() const
+    {
+        return count ? min : 0;
+    }
+
+    uint64_t get_max() const
+    {
+        return max;
+    }
+
+    double mean() const
+    {
+        return count ? (double)sum / count : 0.0;
+    }
+
+    // Upper bound of the bucket holding the q-th quantile (0 < q <= 1), capped at max
+    uint64_t quantile(double q) const
+    {
+        if (!count)
+        {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(q * count + 0.5);
+        rank = std::max((uint64_t)1, std::min(rank, count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+            {
+                return std::min(bucket_high(i), max);
+            }
+        }
+        return max;
+    }
+
+    size_t num_buckets() const
+    {
+        return buckets.size();
+    }
+
+    uint64_t bucket_count(size_t i) const
+    {
+        return buckets[i];
+    }
+
+    // Smallest value of bucket i
+    static uint64_t bucket_low(size_t i)
+    {
+        if (i < SUB_BUCKETS)
+        {
+            return i;
+        }
+        int shift = i / SUB_BUCKETS - 1;
+        return (SUB_BUCKETS + i % SUB_BUCKETS) << shift;
+    }
+
+    // Largest value of bucket i
+    static uint64_t bucket_high(size_t i)
+    {
+        if (i < SUB_BUCKETS)
+        {
+            return i;
+        }
+        int shift = i / SUB_BUCKETS - 1;
+        return bucket_low(i) + ((uint64_t)1 << shift) - 1;
+    }
+
+private:
+    std::vector<uint64_t> buckets;
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+
+    static inline size_t bucket_of(uint64_t value)
+    {
+        if (value < SUB_BUCKETS)
+        {
+            return value;
+        }
+        // Position of the top bit, at least SUB_BITS here
+        int top = 63 - __builtin_clzll(value);
+        int shift = top - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + ((value >> shift) & (SUB_BUCKETS - 1));
+    }
+};
+
+// Paging activity of one virtual page
+typedef struct page_heat
+{
+    unsigned long faults;
+    unsigned long evictions;
+    // Dirty pages written out: OUT / FOUT on eviction or exit, page cleaner, pool write backs
+    unsigned long writebacks;
+    // Fault service cycles of the page's faults
+    unsigned long long cost;
+    // Instruction count of the last fault
+    unsigned long last_fault;
+} page_heat;
+
+/* Fault profile of a run (-M): per process histogram of fault service cost,
+   histogram of re-fault distances and a heatmap of faults / evictions /
+   write backs per page, summed up per VMA on export.
+
+   A fault's service cost is what the fault path charges while it runs
+   (fault_cycles): the map and the page in / zero fill billed to the faulting
+   process plus the unmap and write back of the victim billed to its owner.
+   The re-fault distance is the number of instructions since the page's
+   previous fault. */
+class FaultProfiler
+{
+public:
+    FaultProfiler(Process *process_arr_, unsigned int num_processes)
+    {
+        process_arr = process_arr_;
+        fault_cost.resize(num_processes);
+    }
+
+    void fault_begin(Process *process)
+    {
+        in_fault = true;
+        fault_pid = process->get_pid();
+        fault_start = process->fault_cycles();
+        victim_pid = -1;
+    }
+
+    void fault_end(Process *process, int vpage, unsigned long inst)
+    {
+        unsigned long long cost = process->fault_cycles() - fault_start;
+        if (victim_pid >= 0)
+        {
+            cost += process_arr[victim_pid].fault_cycles() - victim_start;
+        }
+        in_fault = false;
+        fault_cost[fault_pid].record(cost);
+
+        page_heat &heat = heat_of(fault_pid, vpage);
+        if (heat.faults)
+        {
+            refault_distance.record(inst - heat.last_fault);
+        }
+        heat.faults++;
+        heat.cost += cost;
+        heat.last_fault = inst;
+    }
+
+    // A resident page is unmapped to free its frame
+    void eviction(unsigned int pid, int vpage)
+    {
+        heat_of(pid, vpage).evictions++;
+        // The first victim of another process inside a fault, its charges count for the fault
+        if (in_fault && victim_pid < 0 && pid != fault_pid)
+        {
+            victim_pid = pid;
+            victim_start = process_arr[pid].fault_cycles();
+        }
+    }
+
+    void writeback(unsigned int pid, int vpage)
+    {
+        heat_of(pid, vpage).writebacks++;
+    }
+
+    // Records, in this order: fault_cost and refault_distance summaries each
+    // followed by their non empty buckets, vma_heat and page_heat per page
+    void write(StructuredWriter &out)
+    {
+        for (size_t pid = 0; pid < fault_cost.size(); pid++)
+        {
+            write_histogram(out, "fault_cost", pid, fault_cost[pid]);
+        }
+        write_histogram(out, "refault_distance", -1, refault_distance);
+
+        // Pages in (pid, vpage) order, VMA totals come out of the same pass
+        std::map<uint64_t, page_heat> pages(heat.begin(), heat.end());
+        std::map<uint64_t, page_heat> vma_totals;
+        std::map<uint64_t, const vma_range *> vma_ranges;
+        for (std::map<uint64_t, page_heat>::const_iterator it = pages.begin(); it != pages.end(); it++)
+        {
+            unsigned int pid = it->first >> 32;
+            unsigned int vpage = (uint32_t)it->first;
+            const vma_range *vma = process_arr[pid].find_vma(vpage);
+            if (!vma)
+            {
+                continue;
+            }
+            uint64_t key = page_key(pid, vma->START);
+            page_heat &total = vma_totals[key];
+            total.faults += it->second.faults;
+            total.evictions += it->second.evictions;
+            total.writebacks += it->second.writebacks;
+            total.cost += it->second.cost;
+            vma_ranges[key] = vma;
+        }
+        for (std::map<uint64_t, page_heat>::const_iterator it = vma_totals.begin(); it != vma_totals.end(); it++)
+        {
+            const vma_range *vma = vma_ranges[it->first];
+            out.begin("vma_heat", -1, it->first >> 32);
+            out.field("start", vma->START);
+            out.field("end", vma->END);
+            out.field("write_protected", vma->WRITE_PROTECT);
+            out.field("file_mapped", vma->FILEMAPPED);
+            write_heat(out, it->second);
+            out.end();
+        }
+        for (std::map<uint64_t, page_heat>::const_iterator it = pages.begin(); it != pages.end(); it++)
+        {
+            out.begin("page_heat", -1, it->first >> 32);
+            out.field("vpage", (uint32_t)it->first);
+            write_heat(out, it->second);
+            out.end();
+        }
+        out.flush();
+    }
+
+private:
+    Process *process_arr;
+    std::vector<LogHistogram> fault_cost;
+    LogHistogram refault_distance;
+    std::unordered_map<uint64_t, page_heat> heat;
+    bool in_fault = false;
+    unsigned int fault_pid = 0;
+    unsigned long long fault_start = 0;
+    int victim_pid = -1;
+    unsigned long long victim_start = 0;
+
+    page_heat &heat_of(unsigned int pid, int vpage)
+    {
+        // Value initialized, all counters start at 0
+        return heat[page_key(pid, vpage)];
+    }
+
+    static void write_heat(StructuredWriter &out, const page_heat &heat)
+    {
+        out.field("faults", heat.faults);
+        out.field("evictions", heat.evictions);
+        out.field("writebacks", heat.writebacks);
+        out.field("cost", heat.cost);
+    }
+
+    static void write_histogram(StructuredWriter &out, const char *name, long pid, const LogHistogram &histogram)
+    {
+        out.begin(name, -1, pid);
+        out.field("count", histogram.get_count());
+        out.field("min", histogram.get_min());
+        out.field_real("mean", histogram.mean());
+        out.field("p50", histogram.quantile(0.5));
+        out.field("p90", histogram.quantile(0.9));
+        out.field("p99", histogram.quantile(0.99));
+        out.field("p999", histogram.quantile(0.999));
+        out.field("max", histogram.get_max());
+        out.end();
+
+        std::string bucket_name = std::string(name) + "_bucket";
+        for (size_t i = 0; i < histogram.num_buckets(); i++)
+        {
+            if (histogram.bucket_count(i))
+            {
+                out.begin(bucket_name.c_str(), -1, pid);
+                out.field("low", LogHistogram::bucket_low(i));
+                out.field("high", LogHistogram::bucket_high(i));
+                out.field("count", histogram.bucket_count(i));
+                out.end();
+            }
+        }
+    }
+};
+
+#endif
@@ -1,6 +1,14 @@
 #include "data_structures.hpp"
+#include "tlb.hpp"
+#include "buddy_allocator.hpp"
+#include "prefetch.hpp"
+#include "zswap.hpp"
+#include "trace_sink.hpp"
+#include "fault_profile.hpp"
 #include <stdexcept>
-#include <deque>
+#include <string>
+#include <algorithm>
+#include <vector>
 
 #ifndef MMU_PAGERS
 #define MMU_PAGERS
@@ -15,6 +23,8 @@ enum PAGER_CYCLES
     READ_WRITE = 1,
     CONTEXT_SWITCH = 130,
     PROC_EXIT = 1230,
+    // Duplicating the page table and VMAs, a bit more than tearing them down
+    FORK = 1500,
 };
 
 enum ESC_NRU_PAGE_CLASSES
@@ -40,12 +50,40 @@ enum PAGER_TYPES
     Clock,
     ESC_NRU,
     Aging,
-    Working_Set
+    Working_Set,
+    LRU,
+    ARC,
+    CAR,
+    LIRS,
+    CLOCK_Pro
 };
 
 // Helper function
 PAGER_TYPES parse_pager_type_from_input(char *ptype)
 {
+    // Multi letter algorithm names first, otherwise the first letter decides
+    std::string name(ptype);
+    for (size_t i = 0; i < name.size(); i++)
+    {
+        name[i] = std::tolower(name[i]);
+    }
+    if (name == "arc")
+    {
+        return ARC;
+    }
+    if (name == "car")
+    {
+        return CAR;
+    }
+    if (name == "lirs")
+    {
+        return LIRS;
+    }
+    if (name == "clockpro")
+    {
+        return CLOCK_Pro;
+    }
+
     switch (std::toupper(*ptype))
     {
     case 'F':
@@ -60,8 +98,10 @@ PAGER_TYPES parse_pager_type_from_input(char *ptype)
         return Aging;
     case 'W':
         return Working_Set;
+    case 'L':
+        return LRU;
     default:
-        throw std::invalid_argument("Invalid Algorithm Argument, Options Are: F/R/C/E/A/W");
+        throw std::invalid_argument("Invalid Algorithm Argument, Options Are: F/R/C/E/A/W/L/ARC/CAR/LIRS/CLOCKPRO");
     };
 }
 
@@ -74,7 +114,12 @@ char *GET_PAGER_NAME_FROM_ENUM(int enum_code)
         (char *)"Clock",
         (char *)"ESC_NRU",
         (char *)"Aging",
-        (char *)"Working_Set"};
+        (char *)"Working_Set",
+        (char *)"LRU",
+        (char *)"ARC",
+        (char *)"CAR",
+        (char *)"LIRS",
+        (char *)"CLOCK_Pro"};
     return enum_name[enum_code];
 }
 
@@ -85,6 +130,99 @@ public:
     NotImplemented() : std::logic_error("Function not yet implemented"){};
 };
 
+// Replacement scope: global (any frame) or local with per process quotas
+enum LOCAL_MODES
+{
+    GLOBAL_REPLACEMENT,
+    FIXED_QUOTA,
+    PFF_QUOTA
+};
+
+typedef struct local_config
+{
+    LOCAL_MODES mode;
+    // Fixed quota in frames, 0 = an equal share of the frames
+    unsigned int quota;
+    // PFF: a fault within pff_low instructions of the previous one grows the quota,
+    // one more than pff_high instructions after it shrinks the quota
+    unsigned int pff_low;
+    unsigned int pff_high;
+} local_config;
+
+// Parses "fixed[:quota]" or "pff[:low:high]"
+local_config parse_local_config(const std::string &spec)
+{
+    local_config config = {GLOBAL_REPLACEMENT, 0, 10, 100};
+    std::string mode = spec.substr(0, spec.find(':'));
+    std::string args = mode.size() < spec.size() ? spec.substr(mode.size() + 1) : "";
+    if (mode == "fixed")
+    {
+        config.mode = FIXED_QUOTA;
+        if (!args.empty() && sscanf(args.c_str(), "%u", &config.quota) != 1)
+        {
+            throw std::invalid_argument("Invalid fixed quota: " + spec);
+        }
+    }
+    else if (mode == "pff")
+    {
+        config.mode = PFF_QUOTA;
+        if (!args.empty() && (sscanf(args.c_str(), "%u:%u", &config.pff_low, &config.pff_high) != 2 || config.pff_high < config.pff_low))
+        {
+            throw std::invalid_argument("Invalid PFF thresholds (low:high): " + spec);
+        }
+    }
+    else
+    {
+        throw std::invalid_argument("Invalid local replacement mode (fixed / pff): " + spec);
+    }
+    return config;
+}
+
+// One extra mapping of a shared frame (the first one lives in the frame table)
+typedef struct rmap_entry
+{
+    int pid;
+    int vpage;
+    uint32_t next;
+} rmap_entry;
+
+// Per process counters summed over all processes, shared by the TOTALCOST line
+// and the structured total record
+typedef struct pager_totals
+{
+    unsigned long tlb_hits;
+    unsigned long tlb_misses;
+    unsigned long long fault_cycles;
+    unsigned long long writeback_cycles;
+    unsigned long ra_reads;
+    unsigned long ra_hits;
+    unsigned long ra_wasted;
+    unsigned long long ra_cycles;
+    unsigned long cow_copies;
+    unsigned long long zswap_cycles;
+} pager_totals;
+
+// Page cleaner: runs every interval instructions, or as soon as fewer than
+// low frames are clean, and writes dirty pages back until high frames are clean
+typedef struct writeback_config
+{
+    unsigned int interval;
+    unsigned int low;
+    unsigned int high;
+} writeback_config;
+
+// Parses "interval[:low:high]"
+writeback_config parse_writeback_config(const std::string &spec)
+{
+    writeback_config config = {0, 2, 4};
+    int n = sscanf(spec.c_str(), "%u:%u:%u", &config.interval, &config.low, &config.high);
+    if ((n != 1 && n != 3) || config.interval == 0 || config.high < config.low)
+    {
+        throw std::invalid_argument("Invalid write back config (interval[:low:high]): " + spec);
+    }
+    return config;
+}
+
 // Base Class for Pager Algos -> defines interface
 class Pager
 {
@@ -95,9 +233,17 @@ public:
         ptype = ptype_;
         O = O_;
         a = a_;
+        if (O)
+        {
+            tracer = new TraceSink();
+        }
 
         // Dynamically create the frame table array based on input args
         FRAME_TABLE = new frame_t[NUM_FRAMES];
+        referenced_bits.init(NUM_FRAMES);
+        modified_bits.init(NUM_FRAMES);
+        free_bits.init(NUM_FRAMES);
+        free_list.init(NUM_FRAMES);
 
         // Upon Initialization, All frames are free
         for (int i = 0; i < NUM_FRAMES; i++)
@@ -107,275 +253,1602 @@ public:
             FRAME_TABLE[i].age = 0;
 
             // Add it to the free frame queue
-            free_list.push_back(&FRAME_TABLE[i]);
+            free_list.push_back(i);
+            free_bits.set(i);
         }
+        free_count = NUM_FRAMES;
     };
 
-    void init_process_metadata(int num_processes_, Process *process_arr_)
+    virtual ~Pager()
     {
-        process_arr = process_arr_;
-        num_processes = num_processes_;
+        delete[] FRAME_TABLE;
+        delete tlb;
+        delete buddy;
+        delete prefetcher;
+        delete zswap;
+        delete tracer;
+        delete profiler;
     }
 
-    // Main Functionality: Get a frame from the free frames queue
-    // If one does not exist, call select_victim_frame
-    frame_t *get_frame()
+    // O output: per event output goes through the trace sink, and with NO_TRACE
+    // (TraceSink = NullTraceSink) the whole call including the check compiles away
+    inline void trace(TRACE_EVENT_TYPES type, int64_t first = 0, int second = 0, int third = 0)
     {
-        // If we have no free frames, select next victim frame
-        if (free_list.empty())
+        if (TraceSink::enabled && O)
         {
-            return select_victim_frame();
+            tracer->emit(type, first, second, third);
         }
-
-        // If we have free frames, pop & return the first one off
-        frame_t *free_frame = free_list.front();
-        free_list.pop_front();
-        return free_frame;
     }
 
-    // Virtual Function to be implemented by derived classes
-    // Selects VMA to be removed from physical frame
-    // Physical Frame gets added to the free list
-    virtual frame_t *select_victim_frame() { throw new NotImplemented; };
-
-    // Maps a physical frame to a VMA page
-    // pte_t struct -> frame_t struct
-    virtual void map_frame(Process *process, int vpage_num, frame_t *free_frame)
+    // Hands formatting of the O output to a background thread. Only while
+    // nothing else prints during the run (no a option output).
+    void start_async_tracing()
     {
-        // Allocate cost of MAPS + grab vpage
-        process->allocate_cost(MAPS);
-        pte_t *vpage = process->get_vpage(vpage_num);
-
-        // Update VMA page mapping
-        vpage->frame_number = free_frame->frame_number;
-
-        // Update present / referenced / exist bits
-        vpage->PRESENT = 1;
-        vpage->REFERENCED = 1;
-        vpage->EXISTS = 1;
-
-        // See if reading in from file mapped page
-        if (vpage->FILEMAPPED)
-        {
-            process->allocate_cost(FINS);
-            if (O)
-            {
-                printf(" FIN\n");
-            }
-        }
-        // See if we're reading from swap disk
-        else if (vpage->PAGEDOUT)
-        {
-            // Just bill / print the correct amount based on File Mapping
-            process->allocate_cost(INS);
-            if (O)
-            {
-                printf(" IN\n");
-            }
-        }
-        // Otherwise: An operating system must zero pages on first access (unless filemapped) to guarantee consistent behavior
-        else
+        if (O)
         {
-            if (O)
-            {
-                printf(" ZERO\n");
-            }
-            process->allocate_cost(ZEROS);
+            tracer->start_async();
         }
-        // Update physical frame to reverse map to page
-        FRAME_TABLE[free_frame->frame_number].process_id = process->get_pid();
-        FRAME_TABLE[free_frame->frame_number].VMA_page_number = vpage_num;
+    }
 
-        // If output option, display filenumber that is mapped
+    // Drains the O output, everything printed afterwards comes after it
+    void finish_tracing()
+    {
         if (O)
         {
-            printf(" MAP %d\n", free_frame->frame_number);
+            tracer->finish();
         }
-    };
+    }
 
-    virtual void unmap_frame(unsigned int pid, unsigned int old_page_num)
+    // Hands free frames out of a buddy allocator instead of the FIFO free list
+    // Must be called before any frame is allocated
+    void use_buddy_allocator()
     {
-        // Get correct pointer to victim process + frame to be unmapped
-        Process *process = &process_arr[pid];
-        process->allocate_cost(UNMAPS);
-        pte_t *page = process->get_vpage(old_page_num);
+        delete buddy;
+        buddy = new BuddyAllocator(NUM_FRAMES);
+        free_list.init(NUM_FRAMES);
+    }
 
-        // Retrieve Physical Frame Number
-        int frame_num = page->frame_number;
-        int vpage = FRAME_TABLE[frame_num].VMA_page_number;
+    // Puts a TLB in front of the page tables, the pager takes ownership
+    void attach_tlb(Tlb *tlb_)
+    {
+        delete tlb;
+        tlb = tlb_;
+    }
 
-        if (O)
+    // TLB probe for a read/write, counts the hit / miss against the process
+    // Always a miss without a TLB, i.e. every access walks the page table
+    bool tlb_lookup(Process *process, int vpage_num)
+    {
+        if (!tlb)
         {
-            printf(" UNMAP %d:%d\n", pid, vpage);
+            return false;
         }
-
-        // If modified it must be written out
-        if (page->MODIFIED)
+        if (tlb->lookup(process->get_pid(), tlb_key(process, vpage_num)))
         {
-            if (page->FILEMAPPED)
-            {
-                process->allocate_cost(FOUTS);
-                if (O)
-                {
-                    printf(" FOUT\n");
-                }
-            }
-            else
-            {
-                process->allocate_cost(OUTS);
-                // Set PAGEDOUT bit
-                page->PAGEDOUT = 1;
-                if (O)
-                {
-                    printf(" OUT\n");
-                }
-            }
+            process->allocate_cost(TLB_HITS);
+            return true;
+        }
+        process->allocate_cost(TLB_MISSES);
+        return false;
+    }
 
-            // Reset modified bit
-            page->MODIFIED = 0;
+    // Caches the translation of a page that is now present
+    void tlb_fill(Process *process, int vpage_num)
+    {
+        if (tlb)
+        {
+            tlb->insert(process->get_pid(), tlb_key(process, vpage_num));
         }
-        // Clear Physical Frame mapping
-        clear_mapping(frame_num);
+    }
 
-        page->PRESENT = 0;
-    };
+    // Turns on read-ahead, the pager takes ownership of the prefetcher
+    void attach_prefetcher(Prefetcher *prefetcher_)
+    {
+        delete prefetcher;
+        prefetcher = prefetcher_;
+        prefetched_bits.init(NUM_FRAMES);
+    }
 
-    // Clears previous physical frames (reverse) mapping
-    // To a process id / virtual frame number
-    void clear_mapping(int frame_number)
+    // Puts a compressed pool in front of swap, the pager takes ownership
+    void attach_zswap(CompressedPool *zswap_)
     {
-        // Reset frame Numbers
-        FRAME_TABLE[frame_number].process_id = -1;
-        FRAME_TABLE[frame_number].VMA_page_number = -1;
+        delete zswap;
+        zswap = zswap_;
     }
 
-    void allocate_cost(PAGER_CYCLES cost_type)
+    // Records fault costs and per page activity from now on, the pager takes ownership
+    void attach_profiler(FaultProfiler *profiler_)
     {
-        switch (cost_type)
+        delete profiler;
+        profiler = profiler_;
+    }
+
+    FaultProfiler *get_profiler()
+    {
+        return profiler;
+    }
+
+    // Brackets the fault path of a page fault for the fault profile
+    void profile_fault_begin(Process *process)
+    {
+        if (profiler)
         {
-        case READ_WRITE:
-            inst_count++;
-            break;
-        case CONTEXT_SWITCH:
-            inst_count++;
-            ctx_switches++;
-            break;
-        case PROC_EXIT:
-            inst_count++;
-            process_exits++;
-            break;
+            profiler->fault_begin(process);
         }
     }
 
-    void add_frame_to_free_list(frame_t *free_frame)
+    void profile_fault_end(Process *process, int vpage_num)
     {
-        free_list.push_back(free_frame);
+        if (profiler)
+        {
+            profiler->fault_end(process, vpage_num, inst_count);
+        }
     }
 
-    void add_frame_to_free_list(int frame_num)
+    // A dirty page written out, for the fault profile heatmap
+    void profile_writeback(unsigned int pid, int vpage_num)
     {
-        frame_t *temp = &FRAME_TABLE[frame_num];
-        free_list.push_back(temp);
+        if (profiler)
+        {
+            profiler->writeback(pid, vpage_num);
+        }
     }
 
-    // Output as described in the docs
-    void print_total_cost()
+    // "z <percent>" trace annotation, ignored without a compressed pool
+    void set_data_compressibility(Process *process, unsigned int percent)
     {
-        // Incrementally add to avoid overflow
-        cost += inst_count - process_exits - ctx_switches;
-        cost += ctx_switches * CONTEXT_SWITCH;
-        cost += process_exits * PROC_EXIT;
-        for (int i = 0; i < num_processes; i++)
+        if (zswap)
         {
-            cost += process_arr[i].calc_total_cost();
+            zswap->set_data_compressibility(process->get_pid(), percent);
         }
-
-        // Print out total cost information
-        printf("TOTALCOST %lu %lu %lu %llu %lu\n",
-               inst_count, ctx_switches, process_exits, cost, sizeof(pte_t));
     }
 
-    PAGER_TYPES ptype;
+    // Called after a successful write, the page now holds data of the process's current compressibility
+    void note_write(Process *process, int vpage_num)
+    {
+        if (zswap)
+        {
+            zswap->page_written(process->get_pid(), vpage_num);
+        }
+    }
 
-    void print_frame_table()
+    // Called before a read/write is resolved. Faults and first touches of prefetched
+    // pages train the prefetcher, whose candidates are mapped right away.
+    // Returns false without a prefetcher. Making room for the candidates may evict
+    // vpage itself, the access then simply faults it back in.
+    bool read_ahead(Process *process, int vpage_num)
     {
-        printf("FT:");
-        for (int i = 0; i < NUM_FRAMES; i++)
+        if (!prefetcher)
         {
-            int pid = FRAME_TABLE[i].process_id;
-            int page_num = FRAME_TABLE[i].VMA_page_number;
-            if (pid == -1 || page_num == -1)
+            return false;
+        }
+        bool fault = !process->check_present_valid(vpage_num);
+        if (fault && !process->vpage_can_be_accessed(vpage_num))
+        {
+            return true;
+        }
+        if (!fault)
+        {
+            unsigned int frame_num = process->get_frame_num(vpage_num);
+            if (!prefetched_bits.test(frame_num))
             {
-                printf(" *");
+                return true;
             }
-            else
+            prefetched_bits.reset(frame_num);
+            process->allocate_cost(RA_HITS);
+        }
+
+        prefetch_candidates.clear();
+        prefetcher->access(process, vpage_num, fault, prefetch_candidates);
+        for (size_t i = 0; i < prefetch_candidates.size(); i++)
+        {
+            int candidate = prefetch_candidates[i];
+            if (candidate < 0 || candidate >= (int)NUM_PTE || candidate == vpage_num ||
+                !process->vpage_can_be_accessed(candidate) || process->check_present_valid(candidate) ||
+                !process->has_backing_store(candidate) || (zswap && zswap->contains(process->get_pid(), candidate)))
             {
-                printf(" %d:%d", pid, page_num);
+                continue;
             }
+            prefetch_page(process, candidate);
         }
-        printf("\n");
+        return true;
     }
 
-    void print_process_ptes()
+    // Context switch: without ASIDs every cached translation is stale
+    void tlb_context_switch()
     {
-        for (int i = 0; i < num_processes; i++)
+        if (tlb && !tlb->get_config().asids)
         {
-            printf("PT[%d]:", i);
-            process_arr[i].print_process_table();
+            tlb->flush();
         }
     }
 
-    void print_per_process_stats()
+    // Process exit, after its pages were unmapped: drops its TLB entries and reservations
+    void process_exit(Process *process)
     {
-        for (int i = 0; i < num_processes; i++)
+        if (tlb)
+        {
+            tlb->flush_asid(process->get_pid());
+        }
+        if (zswap)
+        {
+            zswap->drop_process(process->get_pid());
+        }
+        if (huge_order)
         {
-            printf("PROC[%d]: ", i);
-            process_arr[i].print_stats();
+            // -1 marks the end of the list
+            int block = reservation_order.front();
+            while (block != -1)
+            {
+                int next = reservation_order.next_of(block);
+                if (reservation_pids[block] == process->get_pid())
+                {
+                    release_reservation(block);
+                }
+                block = next;
+            }
         }
     }
 
-protected:
-    int CLOCK_HAND = 0;
-    int query_len = 0;
-    unsigned int NUM_FRAMES = 0;
-    bool O = false;
-    bool a = false;
-    frame_t *FRAME_TABLE;
-    std::deque<frame_t *> free_list;
-    unsigned long long cost = 0;
-    unsigned long inst_count = 0;
-    unsigned long ctx_switches = 0;
-    unsigned long process_exits = 0;
-    Process *process_arr;
-    int num_processes = 0;
-    void increment_clock_hand()
+    void init_process_metadata(int num_processes_, Process *process_arr_)
     {
-        CLOCK_HAND++;
-        if (CLOCK_HAND >= NUM_FRAMES)
+        process_arr = process_arr_;
+        num_processes = num_processes_;
+        if (local.mode != GLOBAL_REPLACEMENT)
         {
-            CLOCK_HAND = 0;
+            init_local_replacement();
         }
     }
-};
 
-// FIFO Pager Implementation
-class FIFO_Pager : Pager
-{
-public:
-    FIFO_Pager(int NUM_FRAMES, bool O, bool a) : Pager(FIFO, NUM_FRAMES, O, a){};
-    frame_t *select_victim_frame()
+    // Turns on the background page cleaner
+    void use_writeback_daemon(const writeback_config &config)
     {
-        // Select victim frame in clocklike fashion indexing into Frame Table
-        frame_t *free_frame = nullptr;
-        free_frame = &FRAME_TABLE[CLOCK_HAND];
-        increment_clock_hand();
-        // If option selected, output victim frame
-        if (a)
+        writeback = config;
+        dirty_bits.init(NUM_FRAMES);
+    }
+
+    // Called after a successful write: tracks which mapped frames are dirty
+    void mark_dirty(Process *process, int vpage_num)
+    {
+        if (writeback.interval)
         {
-            printf("ASELECT %d\n", free_frame->frame_number);
+            unsigned int frame_num = process->get_frame_num(vpage_num);
+            if (!dirty_bits.test(frame_num))
+            {
+                dirty_bits.set(frame_num);
+                dirty_count++;
+            }
         }
-        return free_frame;
-    };
+    }
+
+    // Called once per instruction, wakes the page cleaner when it is due
+    void writeback_tick()
+    {
+        if (!writeback.interval)
+        {
+            return;
+        }
+        since_writeback++;
+        bool periodic = since_writeback >= writeback.interval;
+        if (periodic || NUM_FRAMES - dirty_count < writeback.low)
+        {
+            since_writeback = 0;
+            run_writeback(periodic);
+        }
+    }
+
+    // 'f' instruction: child_pid gets a copy of parent's address space. Present pages
+    // end up shared through the rmap: anonymous ones copy-on-write, file mapped ones
+    // stay shared for good (MAP_SHARED, same backing file page).
+    void fork_process(Process *parent, int child_pid)
+    {
+        if (child_pid < 0 || child_pid >= num_processes || child_pid == (int)parent->get_pid())
+        {
+            throw std::invalid_argument("Invalid fork target: " + std::to_string(child_pid));
+        }
+        Process *child = &process_arr[child_pid];
+        child->for_each_pte([child_pid](int vpage, pte_t *entry)
+                            {
+            if (entry->PRESENT)
+            {
+                throw std::invalid_argument("Fork target already has mapped pages: " + std::to_string(child_pid));
+            } });
+        if (rmap_head.empty())
+        {
+            rmap_pool.init(1);
+            rmap_head.assign(NUM_FRAMES, 0);
+        }
+
+        child->copy_address_space(*parent);
+        parent->for_each_pte([this, child, child_pid](int vpage, pte_t *entry)
+                             {
+            if (entry->PRESENT)
+            {
+                if (!entry->FILEMAPPED)
+                {
+                    entry->COW = 1;
+                    child->get_vpage(vpage)->COW = 1;
+                }
+                add_sharer(entry->frame_number, child_pid, vpage);
+            } });
+        trace(TRACE_FORK, child_pid);
+    }
+
+    // Successful write to a present page: a copy-on-write page gets a private copy,
+    // unless every other sharer is gone already and the frame can simply be kept
+    void break_cow(Process *process, int vpage_num)
+    {
+        pte_t *page = process->get_vpage(vpage_num);
+        if (!page->COW)
+        {
+            return;
+        }
+        page->COW = 0;
+        int frame_number = page->frame_number;
+        if (!rmap_head[frame_number])
+        {
+            return;
+        }
+
+        // Leave the shared frame (and its dirty state) to the other sharers
+        if (page->HUGE)
+        {
+            demote(process, vpage_num);
+        }
+        leave_shared_frame(process, vpage_num, frame_number);
+        page->PRESENT = 0;
+        page->MODIFIED = 0;
+        if (tlb)
+        {
+            tlb->shootdown(process->get_pid(), vpage_num);
+        }
+
+        // Copy into a frame of its own
+        frame_t *frame = get_frame(process, vpage_num);
+        if (frame->process_id != -1)
+        {
+            unmap_frame(frame->process_id, frame->VMA_page_number);
+        }
+        cow_copying = true;
+        map_frame(process, vpage_num, frame);
+        cow_copying = false;
+        tlb_fill(process, vpage_num);
+    }
+
+    // A sharer's reference counts for the frame's owner too, whose R bit the pagers scan
+    void share_reference(Process *process, int vpage_num)
+    {
+        if (!forks || !process->check_present_valid(vpage_num))
+        {
+            return;
+        }
+        int frame_number = process->get_frame_num(vpage_num);
+        if (rmap_head[frame_number])
+        {
+            process_arr[FRAME_TABLE[frame_number].process_id].set_referenced(FRAME_TABLE[frame_number].VMA_page_number);
+        }
+    }
+
+    // Process exit: if other processes still map the page's frame only this mapping
+    // goes away and true is returned, the frame stays resident
+    bool drop_shared_mapping(Process *process, int vpage_num)
+    {
+        if (!forks)
+        {
+            return false;
+        }
+        int frame_number = process->get_frame_num(vpage_num);
+        if (!rmap_head[frame_number])
+        {
+            return false;
+        }
+        leave_shared_frame(process, vpage_num, frame_number);
+        return true;
+    }
+
+    // Switches to local replacement, takes effect in init_process_metadata
+    void use_local_replacement(const local_config &config)
+    {
+        local = config;
+    }
+
+    // Main Functionality: Get a frame from the free frames queue
+    // If one does not exist, call select_victim_frame
+    frame_t *get_frame(Process *process, int vpage_num)
+    {
+        // Local replacement: a process at its quota replaces one of its own pages
+        if (local.mode != GLOBAL_REPLACEMENT)
+        {
+            unsigned int pid = process->get_pid();
+            if (local.mode == PFF_QUOTA)
+            {
+                adjust_pff_quota(pid);
+            }
+            if (resident[pid] && resident[pid] >= quota[pid])
+            {
+                return select_local_victim(pid);
+            }
+        }
+
+        // Pages of a huge page candidate go to their slot in the block's reservation
+        if (huge_order)
+        {
+            frame_t *reserved = get_reserved_frame(process, vpage_num);
+            if (reserved)
+            {
+                return reserved;
+            }
+            // Under memory pressure unused reserved frames are handed back first
+            while (!free_count && release_oldest_reservation())
+            {
+            }
+        }
+
+        // If we have no free frames, select next victim frame
+        if (!free_count)
+        {
+            if (local.mode != GLOBAL_REPLACEMENT)
+            {
+                return select_local_victim(donor_process());
+            }
+            return select_victim_frame();
+        }
+
+        frame_t *free_frame;
+        if (buddy)
+        {
+            free_frame = &FRAME_TABLE[buddy->allocate(0)];
+        }
+        else
+        {
+            // If we have free frames, pop & return the first one off
+            free_frame = &FRAME_TABLE[free_list.front()];
+            free_list.remove(free_frame->frame_number);
+        }
+        free_bits.reset(free_frame->frame_number);
+        free_count--;
+        return free_frame;
+    }
+
+    // Huge pages of 2^order base pages, 0 = disabled
+    void enable_huge_pages(unsigned int order)
+    {
+        if (order >= VPAGE_BITS)
+        {
+            throw std::invalid_argument("Huge page order must be smaller than VPAGE_BITS");
+        }
+        huge_order = order;
+        if (!huge_order)
+        {
+            return;
+        }
+        unsigned int num_blocks = NUM_FRAMES >> huge_order;
+        reservation_keys.assign(num_blocks, 0);
+        reservation_pids.assign(num_blocks, 0);
+        reservation_index.init(num_blocks);
+        reservation_order.init(num_blocks);
+    }
+
+    // Called after a page was mapped: promotes its block once every page of it
+    // sits in the block's reserved frames
+    void try_promote(Process *process, int vpage_num)
+    {
+        if (!huge_order)
+        {
+            return;
+        }
+        unsigned int block_pages = 1u << huge_order;
+        unsigned int first_vpage = vpage_num & ~(block_pages - 1);
+        int block = reservation_index.find(page_key(process->get_pid(), first_vpage));
+        if (block < 0)
+        {
+            return;
+        }
+        unsigned int first_frame = block << huge_order;
+        for (unsigned int i = 0; i < block_pages; i++)
+        {
+            if (!process->check_present_valid(first_vpage + i) || process->get_frame_num(first_vpage + i) != first_frame + i)
+            {
+                return;
+            }
+        }
+
+        // Block is complete, the reservation becomes the huge mapping
+        remove_reservation(block);
+        for (unsigned int i = 0; i < block_pages; i++)
+        {
+            process->get_vpage(first_vpage + i)->HUGE = 1;
+            if (tlb)
+            {
+                tlb->shootdown(process->get_pid(), first_vpage + i);
+            }
+        }
+        process->allocate_cost(PROMOTES);
+        trace(TRACE_PROMOTE, first_vpage);
+    }
+
+    // Virtual Function to be implemented by derived classes
+    // Selects VMA to be removed from physical frame
+    // Physical Frame gets added to the free list
+    virtual frame_t *select_victim_frame() { throw new NotImplemented; };
+
+    // Maps a physical frame to a VMA page
+    // pte_t struct -> frame_t struct
+    virtual void map_frame(Process *process, int vpage_num, frame_t *free_frame)
+    {
+        // Allocate cost of MAPS + grab vpage
+        process->allocate_cost(MAPS);
+        pte_t *vpage = process->get_vpage(vpage_num);
+
+        // Update VMA page mapping
+        vpage->frame_number = free_frame->frame_number;
+
+        // Update present / referenced / exist bits
+        // (a prefetched page isn't referenced until it is touched)
+        vpage->PRESENT = 1;
+        vpage->REFERENCED = !prefetching;
+        vpage->EXISTS = 1;
+
+        // Private copy of a copy-on-write page
+        if (cow_copying)
+        {
+            process->allocate_cost(COW_COPIES);
+            trace(TRACE_COPY);
+        }
+        // See if reading in from file mapped page
+        else if (vpage->FILEMAPPED)
+        {
+            process->allocate_cost(prefetching ? RA_FINS : FINS);
+            trace(prefetching ? TRACE_RAFIN : TRACE_FIN);
+        }
+        // Swapped out into the compressed pool: decompressed, and dirty as the pool copy is gone
+        else if (vpage->PAGEDOUT && zswap && zswap->load(process->get_pid(), vpage_num))
+        {
+            process->allocate_cost(ZSWAP_LOADS);
+            vpage->MODIFIED = 1;
+            mark_dirty(process, vpage_num);
+            trace(TRACE_ZLOAD);
+        }
+        // See if we're reading from swap disk
+        else if (vpage->PAGEDOUT)
+        {
+            // Just bill / print the correct amount based on File Mapping
+            process->allocate_cost(prefetching ? RA_INS : INS);
+            trace(prefetching ? TRACE_RAIN : TRACE_IN);
+        }
+        // Otherwise: An operating system must zero pages on first access (unless filemapped) to guarantee consistent behavior
+        else
+        {
+            trace(TRACE_ZERO);
+            process->allocate_cost(ZEROS);
+        }
+        if (mirrors_rm_bits)
+        {
+            referenced_bits.assign(free_frame->frame_number, !prefetching);
+            modified_bits.assign(free_frame->frame_number, vpage->MODIFIED);
+        }
+
+        // Update physical frame to reverse map to page
+        FRAME_TABLE[free_frame->frame_number].process_id = process->get_pid();
+        FRAME_TABLE[free_frame->frame_number].VMA_page_number = vpage_num;
+        if (local.mode != GLOBAL_REPLACEMENT)
+        {
+            resident_insert(process->get_pid(), free_frame->frame_number);
+        }
+
+        // If output option, display filenumber that is mapped
+        trace(TRACE_MAP, free_frame->frame_number);
+    };
+
+    virtual void unmap_frame(unsigned int pid, unsigned int old_page_num)
+    {
+        // Get correct pointer to victim process + frame to be unmapped
+        Process *process = &process_arr[pid];
+        if (profiler)
+        {
+            profiler->eviction(pid, old_page_num);
+        }
+        process->allocate_cost(UNMAPS);
+        pte_t *page = process->get_vpage(old_page_num);
+
+        // Evicting part of a huge page splits it back into base pages
+        if (page->HUGE)
+        {
+            demote(process, old_page_num);
+        }
+
+        // Retrieve Physical Frame Number
+        int frame_num = page->frame_number;
+        int vpage = FRAME_TABLE[frame_num].VMA_page_number;
+
+        trace(TRACE_UNMAP, pid, vpage);
+
+        // Every other process sharing the frame loses its mapping as well
+        bool shared = forks && rmap_head[frame_num];
+        if (shared)
+        {
+            unmap_sharers(frame_num, page);
+        }
+
+        // If modified it must be written out
+        if (page->MODIFIED)
+        {
+            if (page->FILEMAPPED)
+            {
+                process->allocate_cost(FOUTS);
+                trace(TRACE_FOUT);
+                profile_writeback(pid, old_page_num);
+            }
+            // Shared anonymous frames keep going to disk, their sharers all refer to that copy
+            else if (zswap && !shared && zswap_store(process, old_page_num))
+            {
+                page->PAGEDOUT = 1;
+            }
+            else
+            {
+                process->allocate_cost(OUTS);
+                // Set PAGEDOUT bit
+                page->PAGEDOUT = 1;
+                trace(TRACE_OUT);
+                profile_writeback(pid, old_page_num);
+            }
+
+            // Reset modified bit
+            page->MODIFIED = 0;
+        }
+        // Clear Physical Frame mapping
+        clear_mapping(frame_num);
+
+        page->PRESENT = 0;
+        if (tlb)
+        {
+            tlb->shootdown(pid, old_page_num);
+        }
+    };
+
+    // Called on a page fault for a valid page, before get_frame picks a frame
+    virtual void page_fault(Process *process, int vpage_num){};
+
+    // Called after a shared frame got a new owner in the frame table (its old owner
+    // left), pagers that index resident pages by (pid, vpage) re-key the frame's page
+    virtual void frame_owner_changed(int frame_number){};
+
+    // Called on every read/write that hits a present page, only if tracks_references is set
+    virtual void reference_frame(unsigned int frame_number){};
+
+    // Clears previous physical frames (reverse) mapping
+    // To a process id / virtual frame number
+    virtual void clear_mapping(int frame_number)
+    {
+        if (mirrors_rm_bits)
+        {
+            referenced_bits.reset(frame_number);
+            modified_bits.reset(frame_number);
+        }
+        if (writeback.interval && dirty_bits.test(frame_number))
+        {
+            dirty_bits.reset(frame_number);
+            dirty_count--;
+        }
+        if (prefetcher && prefetched_bits.test(frame_number))
+        {
+            // Read ahead but never touched
+            int pid = FRAME_TABLE[frame_number].process_id;
+            prefetched_bits.reset(frame_number);
+            process_arr[pid].allocate_cost(RA_WASTED);
+            prefetcher->wasted(pid);
+        }
+        if (local.mode != GLOBAL_REPLACEMENT && FRAME_TABLE[frame_number].process_id != -1)
+        {
+            resident_remove(FRAME_TABLE[frame_number].process_id, frame_number);
+        }
+
+        // Reset frame Numbers
+        FRAME_TABLE[frame_number].process_id = -1;
+        FRAME_TABLE[frame_number].VMA_page_number = -1;
+    }
+
+    void allocate_cost(PAGER_CYCLES cost_type)
+    {
+        switch (cost_type)
+        {
+        case READ_WRITE:
+            inst_count++;
+            break;
+        case CONTEXT_SWITCH:
+            inst_count++;
+            ctx_switches++;
+            break;
+        case PROC_EXIT:
+            inst_count++;
+            process_exits++;
+            break;
+        case FORK:
+            inst_count++;
+            forks++;
+            break;
+        }
+    }
+
+    void add_frame_to_free_list(frame_t *free_frame)
+    {
+        if (buddy)
+        {
+            buddy->free(free_frame->frame_number, 0);
+        }
+        else
+        {
+            free_list.push_back(free_frame->frame_number);
+        }
+        free_bits.set(free_frame->frame_number);
+        free_count++;
+    }
+
+    void add_frame_to_free_list(int frame_num)
+    {
+        add_frame_to_free_list(&FRAME_TABLE[frame_num]);
+    }
+
+    // Sums pager + per process cycle costs
+    unsigned long long calc_total_cost()
+    {
+        // Incrementally add to avoid overflow
+        cost = 0;
+        cost += inst_count - process_exits - ctx_switches - forks;
+        cost += ctx_switches * CONTEXT_SWITCH;
+        cost += process_exits * PROC_EXIT;
+        cost += forks * FORK;
+        for (int i = 0; i < num_processes; i++)
+        {
+            cost += process_arr[i].calc_total_cost();
+        }
+        return cost;
+    }
+
+    // Sums the per process counters of the feature summaries
+    pager_totals calc_totals()
+    {
+        pager_totals totals = {};
+        for (int i = 0; i < num_processes; i++)
+        {
+            totals.tlb_hits += process_arr[i].get_tlb_hits();
+            totals.tlb_misses += process_arr[i].get_tlb_misses();
+            totals.fault_cycles += process_arr[i].fault_cycles();
+            totals.writeback_cycles += process_arr[i].background_cycles();
+            totals.ra_reads += process_arr[i].get_read_aheads();
+            totals.ra_hits += process_arr[i].get_read_ahead_hits();
+            totals.ra_wasted += process_arr[i].get_read_ahead_wasted();
+            totals.ra_cycles += process_arr[i].read_ahead_cycles();
+            totals.cow_copies += process_arr[i].get_count(COW_COPIES);
+            totals.zswap_cycles += process_arr[i].zswap_cycles();
+        }
+        return totals;
+    }
+
+    // Output as described in the docs
+    void print_total_cost(FILE *out = stdout)
+    {
+        calc_total_cost();
+
+        // Print out total cost information
+        fprintf(out, "TOTALCOST %lu %lu %lu %llu %lu",
+               inst_count, ctx_switches, process_exits, cost, sizeof(pte_t));
+        pager_totals totals = calc_totals();
+        // TLB summary: hits misses flushes shootdowns
+        if (tlb)
+        {
+            fprintf(out, " TLB %lu %lu %lu %lu", totals.tlb_hits, totals.tlb_misses, tlb->get_flushes(), tlb->get_shootdowns());
+        }
+        // Page cleaner summary: foreground fault cycles, background write back cycles
+        if (writeback.interval)
+        {
+            fprintf(out, " WB %llu %llu", totals.fault_cycles, totals.writeback_cycles);
+        }
+        // Read-ahead summary: pages read ahead, useful, wasted, read-ahead I/O cycles
+        if (prefetcher)
+        {
+            fprintf(out, " RA %lu %lu %lu %llu", totals.ra_reads, totals.ra_hits, totals.ra_wasted, totals.ra_cycles);
+        }
+        // Fork summary: forks, copy-on-write copies, shared mappings left / at peak (frames saved)
+        if (forks)
+        {
+            fprintf(out, " FORK %lu %lu %lu %lu", forks, totals.cow_copies, shared_mappings, peak_shared_mappings);
+        }
+        // Compressed pool summary: pool frames, entries, used / peak pages, pool cycles
+        if (zswap)
+        {
+            fprintf(out, " ZSWAP %u %u %.2f %.2f %llu", zswap->get_pool_frames(), zswap->entries(), zswap->used_pages(), zswap->peak_pages(), totals.zswap_cycles);
+        }
+        fprintf(out, "\n");
+    }
+
+    PAGER_TYPES ptype;
+
+    // Set by pagers that need to see every reference, not just faults
+    bool tracks_references = false;
+
+    // Set by pagers that scan REFERENCED / MODIFIED bits as per frame bitmaps.
+    // For those the bitmaps are authoritative for mapped frames: scans only
+    // clear bitmap bits and the PTE R bits are synced back before printing.
+    bool mirrors_rm_bits = false;
+
+    // Copies a present page's R / M bits into the frame bitmaps after an access.
+    // Only sets them: an access never clears a bit, and a frame shared after a
+    // fork stays dirty when a sharer that didn't write it touches it.
+    void sync_rm_bits(Process *process, int vpage_num)
+    {
+        if (process->check_present_valid(vpage_num))
+        {
+            pte_t *page = process->get_vpage(vpage_num);
+            if (page->REFERENCED)
+            {
+                referenced_bits.set(page->frame_number);
+            }
+            if (page->MODIFIED)
+            {
+                modified_bits.set(page->frame_number);
+            }
+        }
+    }
+
+    void print_frame_table()
+    {
+        printf("FT:");
+        for (int i = 0; i < NUM_FRAMES; i++)
+        {
+            int pid = FRAME_TABLE[i].process_id;
+            int page_num = FRAME_TABLE[i].VMA_page_number;
+            if (pid == -1 || page_num == -1)
+            {
+                printf(" *");
+            }
+            else
+            {
+                printf(" %d:%d", pid, page_num);
+            }
+        }
+        printf("\n");
+        if (buddy)
+        {
+            buddy->print_stats();
+        }
+    }
+
+    void print_process_ptes()
+    {
+        sync_ptes_from_bitmaps();
+        for (int i = 0; i < num_processes; i++)
+        {
+            printf("PT[%d]:", i);
+            process_arr[i].print_process_table();
+        }
+    }
+
+    // Counters of the enabled features, CW only once the trace has forked
+    stats_options get_stats_options() const
+    {
+        stats_options show;
+        show.tlb = tlb != nullptr;
+        show.huge = huge_order != 0;
+        show.writeback = writeback.interval != 0;
+        show.prefetch = prefetcher != nullptr;
+        show.cow = forks != 0;
+        show.zswap = zswap != nullptr;
+        return show;
+    }
+
+    void print_per_process_stats(FILE *out = stdout)
+    {
+        stats_options show = get_stats_options();
+        for (int i = 0; i < num_processes; i++)
+        {
+            fprintf(out, "PROC[%d]: ", i);
+            process_arr[i].print_stats(out, show);
+            if (local.mode != GLOBAL_REPLACEMENT)
+            {
+                // Final quota / resident set size of the process
+                fprintf(out, "QUOTA[%d]: %u RSS=%u\n", i, quota[i], resident[i]);
+            }
+        }
+    }
+
+    // Legal accesses to a non present page, for the structured time series
+    void count_fault()
+    {
+        faults++;
+    }
+
+    /* Time series sample of the instructions since the last one: faults, fault
+       rate, frames resident per pid (sharers of a forked frame count too) and
+       dirty mapped frames. Scans the frame table, so the cost is O(frames). */
+    void write_interval(StructuredWriter &out)
+    {
+        std::vector<unsigned int> &rss = series_rss;
+        rss.assign(num_processes, 0);
+        unsigned int dirty = 0;
+        for (unsigned int i = 0; i < NUM_FRAMES; i++)
+        {
+            int pid = FRAME_TABLE[i].process_id;
+            if (pid == -1 || FRAME_TABLE[i].VMA_page_number == -1)
+            {
+                continue;
+            }
+            rss[pid]++;
+            bool modified = mirrors_rm_bits ? modified_bits.test(i) : process_arr[pid].get_vpage(FRAME_TABLE[i].VMA_page_number)->MODIFIED;
+            if (forks)
+            {
+                for (uint32_t id = rmap_head[i]; id; id = rmap_pool.get(id)->next)
+                {
+                    rmap_entry *entry = rmap_pool.get(id);
+                    rss[entry->pid]++;
+                    modified = modified || process_arr[entry->pid].get_vpage(entry->vpage)->MODIFIED;
+                }
+            }
+            dirty += modified;
+        }
+
+        unsigned long instructions = inst_count - series_inst;
+        unsigned long new_faults = faults - series_faults;
+        series_inst = inst_count;
+        series_faults = faults;
+        out.begin("interval", inst_count);
+        out.field("instructions", instructions);
+        out.field("faults", new_faults);
+        out.field_real("fault_rate", instructions ? (double)new_faults / instructions : 0.0);
+        out.field("dirty_frames", dirty);
+        out.field_list("rss", rss);
+        out.end();
+    }
+
+    // Structured counterpart of print_per_process_stats + print_total_cost.
+    // Samples the instructions after the last full interval first.
+    void write_structured_stats(StructuredWriter &out)
+    {
+        if (out.get_interval() && series_inst != inst_count)
+        {
+            write_interval(out);
+        }
+        stats_options show = get_stats_options();
+        for (int i = 0; i < num_processes; i++)
+        {
+            out.begin("process", -1, i);
+            process_arr[i].write_stats(out, show);
+            if (local.mode != GLOBAL_REPLACEMENT)
+            {
+                out.field("quota", quota[i]);
+                out.field("rss", resident[i]);
+            }
+            out.end();
+        }
+
+        calc_total_cost();
+        out.begin("total", inst_count);
+        out.field("ctx_switches", ctx_switches);
+        out.field("exits", process_exits);
+        out.field("cost", cost);
+        out.field("pte_size", sizeof(pte_t));
+        out.field("faults", faults);
+        pager_totals totals = calc_totals();
+        if (tlb)
+        {
+            out.field("tlb_hits", totals.tlb_hits);
+            out.field("tlb_misses", totals.tlb_misses);
+            out.field("tlb_flushes", tlb->get_flushes());
+            out.field("tlb_shootdowns", tlb->get_shootdowns());
+        }
+        if (writeback.interval)
+        {
+            out.field("fault_cycles", totals.fault_cycles);
+            out.field("writeback_cycles", totals.writeback_cycles);
+        }
+        if (prefetcher)
+        {
+            out.field("ra_reads", totals.ra_reads);
+            out.field("ra_hits", totals.ra_hits);
+            out.field("ra_wasted", totals.ra_wasted);
+            out.field("ra_cycles", totals.ra_cycles);
+        }
+        if (forks)
+        {
+            out.field("forks", forks);
+            out.field("cow_copies", totals.cow_copies);
+            out.field("shared_mappings", shared_mappings);
+            out.field("peak_shared_mappings", peak_shared_mappings);
+        }
+        if (zswap)
+        {
+            out.field("zswap_pool_frames", zswap->get_pool_frames());
+            out.field("zswap_entries", zswap->entries());
+            out.field_real("zswap_used_pages", zswap->used_pages());
+            out.field_real("zswap_peak_pages", zswap->peak_pages());
+            out.field("zswap_cycles", totals.zswap_cycles);
+        }
+        out.end();
+        out.flush();
+    }
+
+protected:
+    int CLOCK_HAND = 0;
+    int query_len = 0;
+    unsigned int NUM_FRAMES = 0;
+    bool O = false;
+    bool a = false;
+    TraceSink *tracer = nullptr;
+    FaultProfiler *profiler = nullptr;
+    frame_t *FRAME_TABLE;
+    // Free frames in the order they were freed, reservations take theirs out of the middle
+    FrameList free_list;
+    // Same free frames as a bitmap, for the aligned block search
+    FrameBitmap free_bits;
+    unsigned int free_count = 0;
+    FrameBitmap referenced_bits;
+    FrameBitmap modified_bits;
+    unsigned long long cost = 0;
+    unsigned long inst_count = 0;
+    unsigned long ctx_switches = 0;
+    unsigned long process_exits = 0;
+    // Page faults in total / at the last time series sample
+    unsigned long faults = 0;
+    unsigned long series_faults = 0;
+    unsigned long series_inst = 0;
+    std::vector<unsigned int> series_rss;
+    Process *process_arr;
+    int num_processes = 0;
+    Tlb *tlb = nullptr;
+    BuddyAllocator *buddy = nullptr;
+
+    // Reverse map: the frame table holds a frame's owner, further sharers are
+    // chained off rmap_head (0 = not shared). Both are set up by the first fork.
+    unsigned long forks = 0;
+    NodePool<rmap_entry> rmap_pool;
+    std::vector<uint32_t> rmap_head;
+    unsigned long shared_mappings = 0;
+    unsigned long peak_shared_mappings = 0;
+    bool cow_copying = false;
+
+    void add_sharer(int frame_number, int pid, int vpage_num)
+    {
+        uint32_t id = rmap_pool.allocate();
+        rmap_entry *entry = rmap_pool.get(id);
+        entry->pid = pid;
+        entry->vpage = vpage_num;
+        entry->next = rmap_head[frame_number];
+        rmap_head[frame_number] = id;
+        shared_mappings++;
+        peak_shared_mappings = std::max(peak_shared_mappings, shared_mappings);
+    }
+
+    // Unlinks the first sharer, or (pid, vpage) if given
+    void remove_sharer(int frame_number, int pid = -1, int vpage_num = -1)
+    {
+        uint32_t *link = &rmap_head[frame_number];
+        while (*link)
+        {
+            rmap_entry *entry = rmap_pool.get(*link);
+            if (pid == -1 || (entry->pid == pid && entry->vpage == vpage_num))
+            {
+                uint32_t id = *link;
+                *link = entry->next;
+                rmap_pool.release(id);
+                shared_mappings--;
+                return;
+            }
+            link = &entry->next;
+        }
+    }
+
+    // Drops one of several mappings of a frame: the first sharer takes over if the
+    // owner leaves, a dirty frame stays dirty for whoever owns it afterwards
+    void leave_shared_frame(Process *process, int vpage_num, int frame_number)
+    {
+        int pid = process->get_pid();
+        if (FRAME_TABLE[frame_number].process_id == pid && FRAME_TABLE[frame_number].VMA_page_number == vpage_num)
+        {
+            rmap_entry *heir = rmap_pool.get(rmap_head[frame_number]);
+            if (local.mode != GLOBAL_REPLACEMENT)
+            {
+                resident_remove(pid, frame_number);
+                resident_insert(heir->pid, frame_number);
+            }
+            FRAME_TABLE[frame_number].process_id = heir->pid;
+            FRAME_TABLE[frame_number].VMA_page_number = heir->vpage;
+            remove_sharer(frame_number);
+            frame_owner_changed(frame_number);
+        }
+        else
+        {
+            remove_sharer(frame_number, pid, vpage_num);
+        }
+        if (process->get_vpage(vpage_num)->MODIFIED)
+        {
+            process_arr[FRAME_TABLE[frame_number].process_id].set_write(FRAME_TABLE[frame_number].VMA_page_number);
+            if (mirrors_rm_bits)
+            {
+                modified_bits.set(frame_number);
+            }
+        }
+    }
+
+    // Eviction of a shared frame: unmaps every sharer, their dirty bits are folded
+    // into the owner's page which is written back once for all of them
+    void unmap_sharers(int frame_number, pte_t *page)
+    {
+        for (uint32_t id = rmap_head[frame_number]; id; id = rmap_pool.get(id)->next)
+        {
+            pte_t *shared = process_arr[rmap_pool.get(id)->pid].get_vpage(rmap_pool.get(id)->vpage);
+            page->MODIFIED = page->MODIFIED | shared->MODIFIED;
+        }
+        // Anonymous sharers all refer to the one swap copy afterwards
+        bool swapped = !page->FILEMAPPED && (page->PAGEDOUT || page->MODIFIED);
+        while (rmap_head[frame_number])
+        {
+            rmap_entry *entry = rmap_pool.get(rmap_head[frame_number]);
+            Process *sharer = &process_arr[entry->pid];
+            sharer->allocate_cost(UNMAPS);
+            trace(TRACE_UNMAP, entry->pid, entry->vpage);
+            pte_t *shared = sharer->get_vpage(entry->vpage);
+            shared->PRESENT = 0;
+            shared->MODIFIED = 0;
+            shared->COW = 0;
+            shared->PAGEDOUT = shared->PAGEDOUT | swapped;
+            if (tlb)
+            {
+                tlb->shootdown(entry->pid, entry->vpage);
+            }
+            remove_sharer(frame_number);
+        }
+        page->COW = 0;
+    }
+
+    // Compressed swap tier, nullptr = dirty anonymous victims go straight to disk
+    CompressedPool *zswap = nullptr;
+    std::vector<uint64_t> zswap_evicted;
+
+    // Compresses a dirty anonymous victim into the pool, false if it was rejected.
+    // Pages pushed out of a full pool are written to disk, billed to their owners.
+    bool zswap_store(Process *process, int vpage_num)
+    {
+        zswap_evicted.clear();
+        bool stored = zswap->store(process->get_pid(), vpage_num, zswap_evicted);
+        for (size_t i = 0; i < zswap_evicted.size(); i++)
+        {
+            int pid = (int)(zswap_evicted[i] >> 32);
+            int vpage = (int)(zswap_evicted[i] & 0xffffffff);
+            process_arr[pid].allocate_cost(ZSWAP_WRITEBACKS);
+            process_arr[pid].allocate_cost(OUTS);
+            trace(TRACE_ZWB, pid, vpage);
+            profile_writeback(pid, vpage);
+        }
+        process->allocate_cost(stored ? ZSWAP_STORES : ZSWAP_REJECTS);
+        if (stored)
+        {
+            trace(TRACE_ZSTORE);
+        }
+        return stored;
+    }
+
+    // Read-ahead state: frames holding prefetched pages that weren't touched yet
+    Prefetcher *prefetcher = nullptr;
+    FrameBitmap prefetched_bits;
+    std::vector<int> prefetch_candidates;
+    bool prefetching = false;
+
+    // Brings in one read-ahead candidate through the regular fault path, minus the R bit
+    void prefetch_page(Process *process, int vpage_num)
+    {
+        trace(TRACE_READAHEAD, process->get_pid(), vpage_num);
+        page_fault(process, vpage_num);
+        frame_t *frame = get_frame(process, vpage_num);
+        if (frame->process_id != -1)
+        {
+            unmap_frame(frame->process_id, frame->VMA_page_number);
+        }
+        prefetching = true;
+        map_frame(process, vpage_num, frame);
+        prefetching = false;
+        prefetched_bits.set(frame->frame_number);
+        try_promote(process, vpage_num);
+    }
+
+    // Page cleaner state: dirty mapped frames and the cleaner's own clock hand
+    writeback_config writeback = {0, 0, 0};
+    FrameBitmap dirty_bits;
+    unsigned int dirty_count = 0;
+    unsigned int since_writeback = 0;
+    unsigned int cleaner_hand = 0;
+
+    // R bit of a mapped frame without clearing it
+    bool is_referenced(unsigned int frame_number)
+    {
+        if (mirrors_rm_bits)
+        {
+            return referenced_bits.test(frame_number);
+        }
+        return process_arr[FRAME_TABLE[frame_number].process_id].get_vpage(FRAME_TABLE[frame_number].VMA_page_number)->REFERENCED;
+    }
+
+    // Writes one dirty frame back, the page stays mapped but is clean afterwards
+    void clean_frame(unsigned int frame_number)
+    {
+        int pid = FRAME_TABLE[frame_number].process_id;
+        int vpage_num = FRAME_TABLE[frame_number].VMA_page_number;
+        Process *process = &process_arr[pid];
+        pte_t *page = process->get_vpage(vpage_num);
+        if (page->FILEMAPPED)
+        {
+            process->allocate_cost(BG_FOUTS);
+            trace(TRACE_BGFOUT, pid, vpage_num);
+            profile_writeback(pid, vpage_num);
+        }
+        else
+        {
+            // Anonymous pages now have a copy in swap
+            process->allocate_cost(BG_OUTS);
+            page->PAGEDOUT = 1;
+            trace(TRACE_BGOUT, pid, vpage_num);
+            profile_writeback(pid, vpage_num);
+        }
+        page->MODIFIED = 0;
+        if (mirrors_rm_bits)
+        {
+            modified_bits.reset(frame_number);
+        }
+        if (forks)
+        {
+            for (uint32_t id = rmap_head[frame_number]; id; id = rmap_pool.get(id)->next)
+            {
+                pte_t *shared = process_arr[rmap_pool.get(id)->pid].get_vpage(rmap_pool.get(id)->vpage);
+                shared->MODIFIED = 0;
+                shared->PAGEDOUT = page->PAGEDOUT;
+            }
+        }
+        dirty_bits.reset(frame_number);
+        dirty_count--;
+    }
+
+    // A periodic run writes back every dirty frame that wasn't referenced recently,
+    // then (any run) dirty frames are cleaned until high frames are clean again.
+    // Both passes go round the frame table from the cleaner's hand.
+    void run_writeback(bool periodic)
+    {
+        for (int pass = periodic ? 0 : 1; pass < 2; pass++)
+        {
+            for (unsigned int n = 0; n < NUM_FRAMES; n++)
+            {
+                if (pass == 1 && NUM_FRAMES - dirty_count >= writeback.high)
+                {
+                    return;
+                }
+                unsigned int frame_number = cleaner_hand;
+                cleaner_hand = cleaner_hand + 1 < NUM_FRAMES ? cleaner_hand + 1 : 0;
+                if (dirty_bits.test(frame_number) && (pass == 1 || !is_referenced(frame_number)))
+                {
+                    clean_frame(frame_number);
+                }
+            }
+        }
+    }
+
+    // Local replacement: each process's resident frames form a ring (links shared,
+    // a frame belongs to one process) scanned by that process's own clock hand
+    local_config local = {GLOBAL_REPLACEMENT, 0, 0, 0};
+    std::vector<unsigned int> quota;
+    std::vector<unsigned int> resident;
+    std::vector<unsigned long> last_fault;
+    std::vector<int> local_hand;
+    std::vector<int> ring_next;
+    std::vector<int> ring_prev;
+
+    void init_local_replacement()
+    {
+        unsigned int share = std::max(1u, NUM_FRAMES / std::max(1, num_processes));
+        unsigned int initial = local.mode == FIXED_QUOTA && local.quota ? local.quota : share;
+        quota.assign(num_processes, initial);
+        resident.assign(num_processes, 0);
+        last_fault.assign(num_processes, 0);
+        local_hand.assign(num_processes, -1);
+        ring_next.assign(NUM_FRAMES, -1);
+        ring_prev.assign(NUM_FRAMES, -1);
+    }
+
+    // New frames go right behind the hand, i.e. they are scanned last
+    void resident_insert(unsigned int pid, int frame_number)
+    {
+        int hand = local_hand[pid];
+        if (hand == -1)
+        {
+            ring_next[frame_number] = ring_prev[frame_number] = frame_number;
+            local_hand[pid] = frame_number;
+        }
+        else
+        {
+            ring_prev[frame_number] = ring_prev[hand];
+            ring_next[frame_number] = hand;
+            ring_next[ring_prev[hand]] = frame_number;
+            ring_prev[hand] = frame_number;
+        }
+        resident[pid]++;
+    }
+
+    void resident_remove(unsigned int pid, int frame_number)
+    {
+        if (ring_next[frame_number] == frame_number)
+        {
+            local_hand[pid] = -1;
+        }
+        else
+        {
+            if (local_hand[pid] == frame_number)
+            {
+                local_hand[pid] = ring_next[frame_number];
+            }
+            ring_next[ring_prev[frame_number]] = ring_next[frame_number];
+            ring_prev[ring_next[frame_number]] = ring_prev[frame_number];
+        }
+        ring_next[frame_number] = ring_prev[frame_number] = -1;
+        resident[pid]--;
+    }
+
+    // Page fault frequency: frequent faults grow the resident set, rare ones shrink it
+    void adjust_pff_quota(unsigned int pid)
+    {
+        unsigned long interval = inst_count - last_fault[pid];
+        last_fault[pid] = inst_count;
+        if (interval <= local.pff_low && quota[pid] < NUM_FRAMES)
+        {
+            quota[pid]++;
+        }
+        else if (interval > local.pff_high && quota[pid] > 1)
+        {
+            quota[pid]--;
+        }
+    }
+
+    // Process furthest above its quota (or least below it) gives up a frame
+    unsigned int donor_process()
+    {
+        int donor = -1;
+        long best = 0;
+        for (int pid = 0; pid < num_processes; pid++)
+        {
+            long excess = (long)resident[pid] - (long)quota[pid];
+            if (resident[pid] && (donor == -1 || excess > best))
+            {
+                donor = pid;
+                best = excess;
+            }
+        }
+        return donor;
+    }
+
+    // R bit of a mapped frame, from the bitmap for pagers that mirror it
+    bool test_and_clear_referenced(int frame_number)
+    {
+        if (mirrors_rm_bits)
+        {
+            bool referenced = referenced_bits.test(frame_number);
+            referenced_bits.reset(frame_number);
+            return referenced;
+        }
+        pte_t *page = process_arr[FRAME_TABLE[frame_number].process_id].get_vpage(FRAME_TABLE[frame_number].VMA_page_number);
+        bool referenced = page->REFERENCED;
+        page->REFERENCED = 0;
+        return referenced;
+    }
+
+    // Second chance over the process's own ring
+    frame_t *select_local_victim(unsigned int pid)
+    {
+        int hand = local_hand[pid];
+        query_len = 1;
+        while (test_and_clear_referenced(hand))
+        {
+            hand = ring_next[hand];
+            query_len++;
+        }
+        local_hand[pid] = ring_next[hand];
+
+        frame_t *free_frame = &FRAME_TABLE[hand];
+        if (a)
+        {
+            printf("ASELECT pid=%u %d %d | quota=%u resident=%u\n", pid, free_frame->frame_number, query_len, quota[pid], resident[pid]);
+        }
+        return free_frame;
+    }
+
+    // Huge page reservations, one per aligned block of 2^huge_order frames:
+    // block -> owning (pid, first vpage) key, plus key -> block and oldest first order
+    unsigned int huge_order = 0;
+    std::vector<uint64_t> reservation_keys;
+    std::vector<unsigned int> reservation_pids;
+    PageKeyMap reservation_index;
+    FrameList reservation_order;
+
+    // TLB tag: huge pages are cached as one entry per block
+    unsigned int tlb_key(Process *process, int vpage_num)
+    {
+        if (huge_order && process->is_huge(vpage_num))
+        {
+            return (vpage_num >> huge_order) | (1u << 31);
+        }
+        return vpage_num;
+    }
+
+    // Frame reserved for vpage, reserving a block first if its huge page candidate has none
+    frame_t *get_reserved_frame(Process *process, int vpage_num)
+    {
+        unsigned int block_pages = 1u << huge_order;
+        unsigned int first_vpage = vpage_num & ~(block_pages - 1);
+        uint64_t key = page_key(process->get_pid(), first_vpage);
+        int block = reservation_index.find(key);
+        if (block < 0)
+        {
+            // Only aligned blocks inside a single VMA with no pages mapped yet qualify
+            const vma_range *vma = process->find_vma(first_vpage);
+            if (!vma || vma->END < first_vpage + block_pages - 1)
+            {
+                return nullptr;
+            }
+            for (unsigned int i = 0; i < block_pages; i++)
+            {
+                if (process->check_present_valid(first_vpage + i))
+                {
+                    return nullptr;
+                }
+            }
+            block = allocate_block();
+            if (block < 0)
+            {
+                return nullptr;
+            }
+            reserve_block(block, key, process->get_pid());
+        }
+
+        unsigned int frame_num = (block << huge_order) + (vpage_num - first_vpage);
+        if (FRAME_TABLE[frame_num].process_id != -1)
+        {
+            return nullptr;
+        }
+        return &FRAME_TABLE[frame_num];
+    }
+
+    // Aligned block of 2^huge_order free frames, -1 if none
+    int allocate_block()
+    {
+        if (buddy)
+        {
+            int first_frame = buddy->allocate(huge_order);
+            return first_frame < 0 ? -1 : first_frame >> huge_order;
+        }
+        // Without a buddy allocator: first aligned block whose frames are all free
+        unsigned int block_pages = 1u << huge_order;
+        unsigned int num_blocks = NUM_FRAMES >> huge_order;
+        for (unsigned int block = 0; block < num_blocks; block++)
+        {
+            unsigned int first_frame = block << huge_order;
+            unsigned int i = 0;
+            while (i < block_pages && free_bits.test(first_frame + i))
+            {
+                i++;
+            }
+            if (i == block_pages)
+            {
+                return block;
+            }
+        }
+        return -1;
+    }
+
+    void reserve_block(int block, uint64_t key, unsigned int pid)
+    {
+        unsigned int block_pages = 1u << huge_order;
+        unsigned int first_frame = block << huge_order;
+        for (unsigned int i = 0; i < block_pages; i++)
+        {
+            free_bits.reset(first_frame + i);
+            free_list.remove(first_frame + i);
+        }
+        free_count -= block_pages;
+        reservation_keys[block] = key;
+        reservation_pids[block] = pid;
+        reservation_index.insert(key, block);
+        reservation_order.push_back(block);
+    }
+
+    void remove_reservation(int block)
+    {
+        reservation_index.erase(reservation_keys[block]);
+        reservation_order.remove(block);
+    }
+
+    // Drops a reservation, its still unused frames go back on the free list
+    void release_reservation(int block)
+    {
+        remove_reservation(block);
+        unsigned int block_pages = 1u << huge_order;
+        unsigned int first_frame = block << huge_order;
+        for (unsigned int i = 0; i < block_pages; i++)
+        {
+            unsigned int frame_num = first_frame + i;
+            if (FRAME_TABLE[frame_num].process_id == -1 && !free_bits.test(frame_num))
+            {
+                add_frame_to_free_list(frame_num);
+            }
+        }
+    }
+
+    bool release_oldest_reservation()
+    {
+        if (reservation_order.empty())
+        {
+            return false;
+        }
+        release_reservation(reservation_order.front());
+        return true;
+    }
+
+    // Splits the huge page holding vpage back into base pages
+    void demote(Process *process, int vpage_num)
+    {
+        unsigned int block_pages = 1u << huge_order;
+        unsigned int first_vpage = vpage_num & ~(block_pages - 1);
+        if (tlb)
+        {
+            tlb->shootdown(process->get_pid(), tlb_key(process, vpage_num));
+        }
+        for (unsigned int i = 0; i < block_pages; i++)
+        {
+            process->get_vpage(first_vpage + i)->HUGE = 0;
+        }
+        process->allocate_cost(DEMOTES);
+        trace(TRACE_DEMOTE, first_vpage);
+    }
+
+    // Writes the authoritative bitmap R bits back into the PTEs of mapped frames
+    void sync_ptes_from_bitmaps()
+    {
+        if (!mirrors_rm_bits)
+        {
+            return;
+        }
+        for (unsigned int i = 0; i < NUM_FRAMES; i++)
+        {
+            if (FRAME_TABLE[i].process_id != -1)
+            {
+                pte_t *page = process_arr[FRAME_TABLE[i].process_id].get_vpage(FRAME_TABLE[i].VMA_page_number);
+                page->REFERENCED = referenced_bits.test(i);
+            }
+        }
+    }
+
+    void increment_clock_hand()
+    {
+        CLOCK_HAND++;
+        if (CLOCK_HAND >= NUM_FRAMES)
+        {
+            CLOCK_HAND = 0;
+        }
+    }
+};
+
+// FIFO Pager Implementation
+class FIFO_Pager : Pager
+{
+public:
+    FIFO_Pager(int NUM_FRAMES, bool O, bool a) : Pager(FIFO, NUM_FRAMES, O, a){};
+    frame_t *select_victim_frame()
+    {
+        // Select victim frame in clocklike fashion indexing into Frame Table
+        frame_t *free_frame = nullptr;
+        free_frame = &FRAME_TABLE[CLOCK_HAND];
+        increment_clock_hand();
+        // If option selected, output victim frame
+        if (a)
+        {
+            printf("ASELECT %d\n", free_frame->frame_number);
+        }
+        return free_frame;
+    };
 };
 
 // Random Algorithm Implementation
@@ -422,586 +1895,1318 @@ private:
     }
 };
 
-// FIFO Pager Implementation
+// Clock Pager Implementation
+// R bits come from the referenced_bits bitmap: the hand jumps straight to the
+// next unreferenced frame and clears the R bits it passes a word at a time
 class Clock_Pager : Pager
 {
 public:
-    Clock_Pager(int NUM_FRAMES, bool O, bool a) : Pager(Clock, NUM_FRAMES, O, a){};
+    Clock_Pager(int NUM_FRAMES, bool O, bool a) : Pager(Clock, NUM_FRAMES, O, a)
+    {
+        mirrors_rm_bits = true;
+    };
 
     frame_t *select_victim_frame()
     {
-        // Helper variables
-        Process *temp;
-        query_len = 0;
+        unsigned int start_hand_pos = CLOCK_HAND;
+        const FrameBitmap &R = referenced_bits;
+        unsigned int victim = find_first_bit_wrapping(start_hand_pos, NUM_FRAMES, [&R](size_t w)
+                                                      { return ~R.word(w); });
 
-        // Select victim frame in clocklike fashion indexing into Frame Table
+        if (victim == NUM_FRAMES)
+        {
+            // Every frame referenced: one full sweep clears them all, then the start frame goes
+            referenced_bits.reset_all();
+            victim = start_hand_pos;
+            query_len = NUM_FRAMES + 1;
+        }
+        else
+        {
+            // Referenced frames between the hand and the victim get a second chance
+            referenced_bits.reset_range_wrapping(start_hand_pos, victim);
+            query_len = (victim + NUM_FRAMES - start_hand_pos) % NUM_FRAMES + 1;
+        }
+
+        frame_t *free_frame = &FRAME_TABLE[victim];
+        CLOCK_HAND = victim;
+        increment_clock_hand();
+
+        // If option selected, output victim frame
+        if (a)
+        {
+            printf("ASELECT %d %d\n", free_frame->frame_number, query_len);
+        }
+        return free_frame;
+    };
+
+    int get_query_len()
+    {
+        return query_len;
+    }
+};
+
+// ESC_NRU Pager
+// Classes are computed for 64 frames at a time from the R / M bitmaps:
+// class 0 = ~R & ~M, class 1 = ~R & M, class 2 = R & ~M, class 3 = R & M
+class ESC_NRU_Pager : Pager
+{
+public:
+    ESC_NRU_Pager(int NUM_FRAMES, bool O, bool a) : Pager(ESC_NRU, NUM_FRAMES, O, a)
+    {
+        mirrors_rm_bits = true;
+    };
+
+    frame_t *select_victim_frame()
+    {
+        bool reset_ref = check_reset_ref_bit();
+        unsigned int start_hand_pos = CLOCK_HAND;
+        int victim_class = CLASS_0;
+        const FrameBitmap &R = referenced_bits;
+        const FrameBitmap &M = modified_bits;
+
+        // First class 0 frame from the hand ends the scan early
+        unsigned int victim = find_first_bit_wrapping(start_hand_pos, NUM_FRAMES, [&R, &M](size_t w)
+                                                      { return ~R.word(w) & ~M.word(w); });
+        if (victim != NUM_FRAMES)
+        {
+            query_len = (victim + NUM_FRAMES - start_hand_pos) % NUM_FRAMES + 1;
+        }
+        else
+        {
+            // Whole frame table visited, take the first frame of the lowest class seen
+            query_len = NUM_FRAMES;
+            victim = find_first_bit_wrapping(start_hand_pos, NUM_FRAMES, [&R, &M](size_t w)
+                                             { return ~R.word(w) & M.word(w); });
+            victim_class = CLASS_1;
+            if (victim == NUM_FRAMES)
+            {
+                victim = find_first_bit_wrapping(start_hand_pos, NUM_FRAMES, [&R, &M](size_t w)
+                                                 { return R.word(w) & ~M.word(w); });
+                victim_class = CLASS_2;
+            }
+            if (victim == NUM_FRAMES)
+            {
+                victim = find_first_bit_wrapping(start_hand_pos, NUM_FRAMES, [&R, &M](size_t w)
+                                                 { return R.word(w) & M.word(w); });
+                victim_class = CLASS_3;
+            }
+        }
+
+        // A reset visits (or finishes visiting) every frame, so all R bits go
+        if (reset_ref)
+        {
+            referenced_bits.reset_all();
+        }
+
+        frame_t *free_frame = &FRAME_TABLE[victim];
+
+        // Output desired information
+        if (a)
+        {
+            printf("ASELECT hand=%2d %d | %d %2d %2d\n", start_hand_pos, reset_ref, victim_class, free_frame->frame_number, query_len);
+        }
+
+        // Increment hand before next invocation
+        CLOCK_HAND = free_frame->frame_number + 1;
+
+        if (CLOCK_HAND >= NUM_FRAMES)
+        {
+            CLOCK_HAND = 0;
+        }
+        // Return free frame
+        return free_frame;
+    }
+
+    // Helper function to see if enough instructions have passed
+    // that we should reset the reference bit
+    bool check_reset_ref_bit()
+    {
+        // First instruction is instruction 0, makin this an annoying off-by 1 error
+        if ((inst_count - last_sweep_inst_count) >= (RESET_REFBIT_THRESHOLD))
+        {
+            last_sweep_inst_count = inst_count;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    const int RESET_REFBIT_THRESHOLD = 50;
+    unsigned long last_sweep_inst_count = 0;
+};
+
+class Aging_Pager : Pager
+{
+public:
+    Aging_Pager(int NUM_FRAMES, bool O, bool a) : Pager(Aging, NUM_FRAMES, O, a){};
+
+    frame_t *select_victim_frame()
+    {
+        // Helper vars
+        int start_hand_pos = CLOCK_HAND;
         frame_t *free_frame = nullptr;
+        frame_t *temp_youngest = nullptr;
+        unsigned int youngest_age = 0;
+
+        // Rest query len
+        query_len = 0;
+
+        if (a)
+        {
+            if (start_hand_pos == 0)
+            {
+                printf("ASELECT %d-%d | ", start_hand_pos, NUM_FRAMES - 1);
+            }
+            else
+            {
+                printf("ASELECT %d-%d | ", start_hand_pos, start_hand_pos - 1);
+            }
+        }
+        // Iterate over all frames only once
         while (!free_frame)
         {
-            // Select candidate victim frame
-            free_frame = &FRAME_TABLE[CLOCK_HAND];
+            if (start_hand_pos == CLOCK_HAND && (query_len > 0))
+            {
+                break;
+            }
 
-            // Grab relevant Process / Frame
-            temp = &process_arr[free_frame->process_id];
-            pte_t *page = temp->get_vpage(free_frame->VMA_page_number);
+            // Grab frame / age
+            frame_t *potential_victim_frame = &FRAME_TABLE[CLOCK_HAND];
 
-            // Inspect Referenced bit
-            if (page->REFERENCED)
+            // Age the frame we just considered
+            age_frame(potential_victim_frame);
+            unsigned int potential_victim_age = potential_victim_frame->age;
+            if (a)
             {
-                // If it has been referenced, reset the R bit
-                page->REFERENCED = 0;
+                printf("%d:%X ", potential_victim_frame->frame_number, potential_victim_frame->age);
+            }
 
-                // Reset free_frame to keep looping
-                free_frame = nullptr;
+            // If this is the first, it counts as the youngest (temporarily)
+            if (youngest_age == 0)
+            {
+                youngest_age = potential_victim_age;
+                temp_youngest = potential_victim_frame;
+            }
+            else
+            {
+                // Update youngest found if current is younger
+                if (potential_victim_age < youngest_age)
+                {
+                    youngest_age = potential_victim_age;
+                    temp_youngest = potential_victim_frame;
+                }
             }
 
-            // No Else statement needed, if free_frame NOTEQ nullptr
-            // Then loop exits and free frame returned
-            increment_clock_hand();
-            query_len++;
-        }
-        // If option selected, output victim frame
-        if (a)
+            // Keep searching
+            increment_clock_hand();
+            query_len++;
+        }
+
+        free_frame = temp_youngest;
+        // Reset clock hand and return free frame
+        CLOCK_HAND = free_frame->frame_number;
+        increment_clock_hand();
+
+        if (a)
+        {
+            printf("| %d\n", free_frame->frame_number);
+        }
+
+        return free_frame;
+    };
+
+    void map_frame(Process *process, int vpage_num, frame_t *free_frame)
+    {
+        // Reset Age every MAP operation
+        free_frame->age = 0;
+
+        Pager::map_frame(process, vpage_num, free_frame);
+    }
+
+    void unmap_frame(unsigned int pid, unsigned int old_page_num)
+    {
+        Pager::unmap_frame(pid, old_page_num);
+    }
+
+private:
+    void age_frame(frame_t *potential_victim_frame)
+    {
+        // Get VPAGE
+        Process *temp = &process_arr[potential_victim_frame->process_id];
+        pte_t *page = temp->get_vpage(potential_victim_frame->VMA_page_number);
+
+        // Shift Right
+        shift_age_right(potential_victim_frame);
+
+        // Add R bit to leading
+        if (page->REFERENCED)
+        {
+            set_leading_bit_to_one(potential_victim_frame);
+        }
+        // If its 1, must be reset to 0
+        page->REFERENCED = 0;
+    }
+
+    inline void set_leading_bit_to_one(frame_t *frame)
+    {
+        frame->age = frame->age | 0x80000000;
+    }
+
+    inline void shift_age_right(frame_t *frame)
+    {
+        frame->age = frame->age >> 1;
+    }
+
+    void increment_clock_hand()
+    {
+        CLOCK_HAND++;
+        if (CLOCK_HAND >= NUM_FRAMES)
         {
-            printf("ASELECT %d %d\n", free_frame->frame_number, query_len);
+            CLOCK_HAND = 0;
         }
-        return free_frame;
-    };
-
-    int get_query_len()
-    {
-        return query_len;
     }
 };
 
-// ESC_NRU Pager
-class ESC_NRU_Pager : Pager
+class Working_Set_Pager : Pager
 {
 public:
-    ESC_NRU_Pager(int NUM_FRAMES, bool O, bool a) : Pager(ESC_NRU, NUM_FRAMES, O, a){};
+    Working_Set_Pager(int NUM_FRAMES, bool O, bool a) : Pager(Working_Set, NUM_FRAMES, O, a)
+    {
+        mirrors_rm_bits = true;
+    };
 
     frame_t *select_victim_frame()
     {
-        bool reset_ref = check_reset_ref_bit();
-        int start_hand_pos = CLOCK_HAND;
-        int victim_class = 0;
-        query_len = 0;
-        Process *temp;
+        // Helper vars
         frame_t *free_frame = nullptr;
-        frame_t *potential_victim_frame = nullptr;
-
-        // if reset_ref we must scan all entries and reset all bits
-        // Search frame list -> O(n) where n = NUM_FRAMES
-        while (!free_frame)
-        {
-            // Check if we've already completed a whole frame scan
-            // Each frame only needs to be visited once
-            if (start_hand_pos == CLOCK_HAND && (query_len > 0))
-            {
-                break;
-            }
-
-            // Select candidate victim frame
-            potential_victim_frame = &FRAME_TABLE[CLOCK_HAND];
-
-            // Grab relevant Process / Frame
-            temp = &process_arr[potential_victim_frame->process_id];
-            pte_t *page = temp->get_vpage(potential_victim_frame->VMA_page_number);
+        unsigned int start_hand_pos = CLOCK_HAND;
+        unsigned int stop = NUM_FRAMES;
+        const FrameBitmap &R = referenced_bits;
+        query_len = 0;
 
-            // First check for class 0
-            if (is_class_zero(page))
-            {
-                free_frame = potential_victim_frame;
-                victim_class = CLASS_0;
-            }
+        // Keep track of candidate victim frames
+        frame_t *oldest_class_one_frame = nullptr;
+        frame_t *oldest_class_two_frame = nullptr;
+        unsigned int oldest_class_one_age = 0;
 
-            // Otherwise check what class
-            else
+        // Only unreferenced frames can be class 0 / 1, jump between them with the R bitmap
+        // Visit order is [hand, NUM_FRAMES) then [0, hand)
+        for (int pass = 0; pass < 2 && stop == NUM_FRAMES; pass++)
+        {
+            unsigned int from = pass == 0 ? start_hand_pos : 0;
+            unsigned int to = pass == 0 ? NUM_FRAMES : start_hand_pos;
+            for (unsigned int i = find_first_bit(from, to, [&R](size_t w)
+                                                 { return ~R.word(w); });
+                 i < to;
+                 i = find_first_bit(i + 1, to, [&R](size_t w)
+                                    { return ~R.word(w); }))
             {
-                ESC_NRU_PAGE_CLASSES page_class = get_class(page);
+                frame_t *potential_victim_frame = &FRAME_TABLE[i];
 
-                // Update the class pointer if we haven't found one like it
-                switch (page_class)
+                // Class = 0 means frame age >= TAU and REF = 0
+                if (is_class_zero(potential_victim_frame))
                 {
-                case CLASS_1:
-                    if (class_one_frame == nullptr)
-                    {
-                        class_one_frame = potential_victim_frame;
-                    }
-                    break;
-                case CLASS_2:
-                    if (class_two_frame == nullptr)
-                    {
-                        class_two_frame = potential_victim_frame;
-                    }
-                    break;
-                case CLASS_3:
-                    if (class_three_frame == nullptr)
-                    {
-                        class_three_frame = potential_victim_frame;
-                    }
+                    stop = i;
                     break;
                 }
-            }
 
-            // Reset the referenced bit if that's whats required
-            if (reset_ref)
-            {
-                page->REFERENCED = 0;
-
-                // If we've found a free frame, finish resetting all bits
-                if (free_frame)
+                // Class 1: A unreferenced page with age < TAU
+                // If this is the first frame we've seen of this class, by default it is the oldest
+                if (oldest_class_one_age == 0 || potential_victim_frame->age < oldest_class_one_age)
                 {
-                    finish_resetting_ref_bit(start_hand_pos);
+                    oldest_class_one_age = potential_victim_frame->age;
+                    oldest_class_one_frame = potential_victim_frame;
                 }
             }
+        }
 
-            // Increment hand and continue
-            increment_clock_hand();
-            query_len++;
+        // Frames visited before the stop (or all of them)
+        unsigned int visited = stop == NUM_FRAMES ? NUM_FRAMES : (stop + NUM_FRAMES - start_hand_pos) % NUM_FRAMES;
+        query_len = visited;
+
+        // Class 2 frames are the referenced ones among the visited: the first one is the
+        // fallback victim, all of them get their R bit reset and their age set
+        unsigned int visited_end = (start_hand_pos + visited) % NUM_FRAMES;
+        unsigned int first_referenced = find_first_bit_wrapping(start_hand_pos, NUM_FRAMES, [&R](size_t w)
+                                                                { return R.word(w); });
+        if (first_referenced != NUM_FRAMES && (first_referenced + NUM_FRAMES - start_hand_pos) % NUM_FRAMES < visited)
+        {
+            oldest_class_two_frame = &FRAME_TABLE[first_referenced];
         }
 
-        // If we haven't found a Class 0 frame and we've visited all frames, select lowest class as vitcim
-        if (free_frame == nullptr)
+        // Option for verbose output, printed before the R bits / ages change
+        if (a)
         {
-            if (class_one_frame != nullptr)
-            {
-                free_frame = class_one_frame;
-                victim_class = CLASS_1;
-                increment_clock_hand();
-            }
-            else if (class_two_frame != nullptr)
+            print_scan(start_hand_pos, visited, stop != NUM_FRAMES);
+        }
+
+        for (unsigned int n = 0, i = start_hand_pos; n < visited; n++)
+        {
+            if (referenced_bits.test(i))
             {
-                free_frame = class_two_frame;
-                victim_class = CLASS_2;
-                increment_clock_hand();
+                // -1 as count gets incremented on read/write allocation before frame is allocated
+                FRAME_TABLE[i].age = inst_count - 1;
             }
-            else
+            if (++i == NUM_FRAMES)
             {
-                free_frame = class_three_frame;
-                victim_class = CLASS_3;
-                increment_clock_hand();
+                i = 0;
             }
         }
-
-        // Output desired information
-        if (a)
+        if (visited == NUM_FRAMES)
         {
-            printf("ASELECT hand=%2d %d | %d %2d %2d\n", start_hand_pos, reset_ref, victim_class, free_frame->frame_number, query_len);
+            referenced_bits.reset_all();
+        }
+        else
+        {
+            referenced_bits.reset_range_wrapping(start_hand_pos, visited_end);
         }
 
-        // Increment hand before next invocation, clear class pointers
-        clear_class_pointers();
-        CLOCK_HAND = free_frame->frame_number + 1;
+        if (stop != NUM_FRAMES)
+        {
+            free_frame = &FRAME_TABLE[stop];
+        }
+        // If we didn't find a frame in the loop, then we select the youngest
+        else if (oldest_class_one_frame)
+        {
+            free_frame = oldest_class_one_frame;
+        }
+        else
+        {
+            free_frame = oldest_class_two_frame;
+        }
 
-        if (CLOCK_HAND >= NUM_FRAMES)
+        // Set clock hand back to appropriate spot
+        CLOCK_HAND = free_frame->frame_number;
+        increment_clock_hand();
+        if (a)
         {
-            CLOCK_HAND = 0;
+            printf("| %d\n", free_frame->frame_number);
         }
-        // Return free frame
+
         return free_frame;
     }
 
-    // Helper function that continues sweep if class=0 is found early
-    // But frames still need to be traversed to reset all reference bits  to 0
-    void finish_resetting_ref_bit(int starting_pos)
+    void map_frame(Process *process, int vpage_num, frame_t *free_frame)
     {
-        // Helper vars
-        int starting_clock_hand = CLOCK_HAND;
-        frame_t *free_frame;
-        Process *temp;
-        pte_t *page;
+        // When mapping a frame set its age to instruction count
+        // -1 as inst_count is incremented before frames are allocated
+        // due to the accounting i've set up with billing read/writes
+        free_frame->age = inst_count - 1;
 
-        // Increment the clock hand before and after for desired behvaior
-        increment_clock_hand();
+        Pager::map_frame(process, vpage_num, free_frame);
+    }
+
+private:
+    const unsigned int TAU = 49;
+
+    // Helper function to determine if an unreferenced frame belongs to class 0
+    bool is_class_zero(frame_t *frame)
+    {
+        if ((inst_count - frame->age - 1) > TAU)
+        {
+            return true;
+        }
+        return false;
+    }
 
-        while (CLOCK_HAND != starting_pos)
+    // Verbose per frame output of a scan, values as they were before the scan
+    void print_scan(unsigned int start_hand_pos, unsigned int visited, bool stopped)
+    {
+        if (start_hand_pos == 0)
+        {
+            printf("ASELECT %d-%d | ", start_hand_pos, NUM_FRAMES - 1);
+        }
+        else
         {
-            // Select candidate victim frame
-            free_frame = &FRAME_TABLE[CLOCK_HAND];
+            printf("ASELECT %d-%d | ", start_hand_pos, start_hand_pos - 1);
+        }
 
-            // Grab relevant Process / Frame
-            temp = &process_arr[free_frame->process_id];
-            page = temp->get_vpage(free_frame->VMA_page_number);
+        unsigned int i = start_hand_pos;
+        for (unsigned int n = 0; n <= visited && n < NUM_FRAMES; n++)
+        {
+            // The stop frame is printed too, but doesn't count as visited
+            if (n == visited && !stopped)
+            {
+                break;
+            }
+            frame_t *frame = &FRAME_TABLE[i];
+            printf("%d(%d %d:%d %d) ", i, referenced_bits.test(i), frame->process_id,
+                   frame->VMA_page_number, frame->age);
+            if (++i == NUM_FRAMES)
+            {
+                i = 0;
+            }
+        }
+        if (stopped)
+        {
+            printf("STOP(%d) ", visited);
+        }
+    }
+};
 
-            // Reset R bit
-            page->REFERENCED = 0;
-            increment_clock_hand();
+// Exact LRU: mapped frames are kept in recency order on an index based
+// doubly linked list (FrameList), so every reference and every victim
+// selection is O(1)
+class LRU_Pager : Pager
+{
+public:
+    LRU_Pager(int NUM_FRAMES, bool O, bool a) : Pager(LRU, NUM_FRAMES, O, a)
+    {
+        tracks_references = true;
+        recency.init(NUM_FRAMES);
+    };
+
+    frame_t *select_victim_frame()
+    {
+        // Least recently used frame sits at the back
+        frame_t *free_frame = &FRAME_TABLE[recency.back()];
+        if (a)
+        {
+            printf("ASELECT %d\n", free_frame->frame_number);
         }
+        return free_frame;
+    }
 
-        // Reset clock hand to where it was as it was entered
-        CLOCK_HAND = starting_clock_hand;
+    void map_frame(Process *process, int vpage_num, frame_t *free_frame)
+    {
+        Pager::map_frame(process, vpage_num, free_frame);
+        recency.push_front(free_frame->frame_number);
     }
 
-    // Helper function to see if enough instructions have passed
-    // that we should reset the reference bit
-    bool check_reset_ref_bit()
+    void reference_frame(unsigned int frame_number)
     {
-        // First instruction is instruction 0, makin this an annoying off-by 1 error
-        if ((inst_count - last_sweep_inst_count) >= (RESET_REFBIT_THRESHOLD))
+        if (recency.front() != (int)frame_number)
         {
-            last_sweep_inst_count = inst_count;
-            return true;
+            recency.remove(frame_number);
+            recency.push_front(frame_number);
         }
-        return false;
     }
 
-    // Helper function to determine if page belongs to class 0
-    bool is_class_zero(pte_t *page)
+    void clear_mapping(int frame_number)
+    {
+        recency.remove(frame_number);
+        Pager::clear_mapping(frame_number);
+    }
+
+private:
+    FrameList recency;
+};
+
+// Adaptive Replacement Cache (Megiddo & Modha)
+// T1 / T2 hold resident frames seen once / at least twice (front = MRU),
+// B1 / B2 hold the keys of pages recently evicted from T1 / T2.
+// Ghost hits adapt the target size p of T1, which makes it scan resistant.
+class ARC_Pager : Pager
+{
+public:
+    ARC_Pager(int NUM_FRAMES, bool O, bool a) : Pager(ARC, NUM_FRAMES, O, a)
+    {
+        tracks_references = true;
+        T1.init(NUM_FRAMES);
+        T2.init(NUM_FRAMES);
+        B1.init(NUM_FRAMES);
+        B2.init(NUM_FRAMES);
+    };
+
+    void page_fault(Process *process, int vpage_num)
     {
-        if ((!page->MODIFIED) && (!page->REFERENCED))
+        fault_key = page_key(process->get_pid(), vpage_num);
+        in_b1 = B1.contains(fault_key);
+        in_b2 = B2.contains(fault_key);
+
+        // Ghost hits move the target size towards the list that would have hit
+        if (in_b1)
         {
-            return true;
+            p = std::min(NUM_FRAMES, p + std::max(1u, B2.size() / B1.size()));
+        }
+        else if (in_b2)
+        {
+            unsigned int delta = std::max(1u, B1.size() / B2.size());
+            p = p > delta ? p - delta : 0;
         }
-        return false;
     }
 
-    // Get page classes (1-3) from page table entry
-    ESC_NRU_PAGE_CLASSES get_class(pte_t *page)
+    frame_t *select_victim_frame()
     {
-        if ((!page->REFERENCED) && (page->MODIFIED))
+        int victim;
+        if (!in_b1 && !in_b2 && T1.size() + B1.size() >= NUM_FRAMES)
         {
-            return CLASS_1;
+            if (T1.size() < NUM_FRAMES)
+            {
+                B1.pop_back();
+                victim = replace();
+            }
+            else
+            {
+                // B1 is empty and T1 fills the cache, drop its LRU page without history
+                victim = T1.back();
+            }
         }
-        else if ((page->REFERENCED) && (!page->MODIFIED))
+        else
         {
-            return CLASS_2;
+            if (!in_b1 && !in_b2 && T1.size() + T2.size() + B1.size() + B2.size() >= 2 * NUM_FRAMES)
+            {
+                B2.pop_back();
+            }
+            victim = replace();
         }
-        else if ((page->REFERENCED) && (page->MODIFIED))
+
+        frame_t *free_frame = &FRAME_TABLE[victim];
+        if (a)
         {
-            return CLASS_3;
+            printf("ASELECT %d | p=%u T1=%u T2=%u B1=%u B2=%u\n", free_frame->frame_number, p, T1.size(), T2.size(), B1.size(), B2.size());
         }
+        return free_frame;
     }
 
-    // Helper function to clear class pointers between invocations
-    void clear_class_pointers()
+    void map_frame(Process *process, int vpage_num, frame_t *free_frame)
     {
-        class_one_frame = nullptr;
-        class_two_frame = nullptr;
-        class_three_frame = nullptr;
+        Pager::map_frame(process, vpage_num, free_frame);
+
+        // Pages with history go straight to the frequency side
+        if (in_b1 || in_b2)
+        {
+            B1.remove(fault_key);
+            B2.remove(fault_key);
+            T2.push_front(free_frame->frame_number);
+        }
+        else
+        {
+            T1.push_front(free_frame->frame_number);
+        }
+        in_b1 = in_b2 = false;
     }
 
-private:
-    const int RESET_REFBIT_THRESHOLD = 50;
-    unsigned long last_sweep_inst_count = 0;
-    frame_t *class_one_frame = nullptr;
-    frame_t *class_two_frame = nullptr;
-    frame_t *class_three_frame = nullptr;
+    void reference_frame(unsigned int frame_number)
+    {
+        // Any hit makes the page frequent
+        T1.remove(frame_number);
+        T2.remove(frame_number);
+        T2.push_front(frame_number);
+    }
 
-    void increment_clock_hand()
+    void clear_mapping(int frame_number)
     {
-        CLOCK_HAND++;
-        if (CLOCK_HAND >= NUM_FRAMES)
+        T1.remove(frame_number);
+        T2.remove(frame_number);
+        Pager::clear_mapping(frame_number);
+    }
+
+private:
+    FrameList T1;
+    FrameList T2;
+    GhostList B1;
+    GhostList B2;
+    unsigned int p = 0;
+    uint64_t fault_key = 0;
+    bool in_b1 = false;
+    bool in_b2 = false;
+
+    // Picks the LRU page of T1 or T2 (per target p) and remembers it in B1 / B2
+    int replace()
+    {
+        int victim;
+        if (!T1.empty() && (T1.size() > p || (in_b2 && T1.size() == p) || T2.empty()))
         {
-            CLOCK_HAND = 0;
+            victim = T1.back();
+            B1.push_front(frame_key(victim));
+        }
+        else
+        {
+            victim = T2.back();
+            B2.push_front(frame_key(victim));
         }
+        return victim;
+    }
+
+    inline uint64_t frame_key(int frame_number)
+    {
+        return page_key(FRAME_TABLE[frame_number].process_id, FRAME_TABLE[frame_number].VMA_page_number);
     }
 };
 
-class Aging_Pager : Pager
+// Clock with Adaptive Replacement (Bansal & Modha)
+// ARC's policy with T1 / T2 kept as clocks (front = hand) and per frame
+// reference bits, so hits only set a bit instead of moving list entries.
+class CAR_Pager : Pager
 {
 public:
-    Aging_Pager(int NUM_FRAMES, bool O, bool a) : Pager(Aging, NUM_FRAMES, O, a){};
+    CAR_Pager(int NUM_FRAMES, bool O, bool a) : Pager(CAR, NUM_FRAMES, O, a)
+    {
+        tracks_references = true;
+        T1.init(NUM_FRAMES);
+        T2.init(NUM_FRAMES);
+        B1.init(NUM_FRAMES);
+        B2.init(NUM_FRAMES);
+        ref_bits.assign(NUM_FRAMES, false);
+    };
 
-    frame_t *select_victim_frame()
+    void page_fault(Process *process, int vpage_num)
     {
-        // Helper vars
-        int start_hand_pos = CLOCK_HAND;
-        frame_t *free_frame = nullptr;
-        frame_t *temp_youngest = nullptr;
-        unsigned int youngest_age = 0;
+        fault_key = page_key(process->get_pid(), vpage_num);
+        in_b1 = B1.contains(fault_key);
+        in_b2 = B2.contains(fault_key);
+    }
 
-        // Rest query len
+    frame_t *select_victim_frame()
+    {
         query_len = 0;
+        int victim = replace();
 
-        if (a)
+        // Keep the history directory bounded for pages without history
+        if (!in_b1 && !in_b2)
         {
-            if (start_hand_pos == 0)
+            if (T1.size() + B1.size() >= NUM_FRAMES)
             {
-                printf("ASELECT %d-%d | ", start_hand_pos, NUM_FRAMES - 1);
+                B1.pop_back();
             }
-            else
+            else if (T1.size() + T2.size() + B1.size() + B2.size() >= 2 * NUM_FRAMES)
             {
-                printf("ASELECT %d-%d | ", start_hand_pos, start_hand_pos - 1);
+                B2.pop_back();
             }
         }
-        // Iterate over all frames only once
-        while (!free_frame)
+
+        frame_t *free_frame = &FRAME_TABLE[victim];
+        if (a)
         {
-            if (start_hand_pos == CLOCK_HAND && (query_len > 0))
-            {
-                break;
-            }
+            printf("ASELECT %d %d | p=%u T1=%u T2=%u B1=%u B2=%u\n", free_frame->frame_number, query_len, p, T1.size(), T2.size(), B1.size(), B2.size());
+        }
+        return free_frame;
+    }
 
-            // Grab frame / age
-            frame_t *potential_victim_frame = &FRAME_TABLE[CLOCK_HAND];
+    void map_frame(Process *process, int vpage_num, frame_t *free_frame)
+    {
+        Pager::map_frame(process, vpage_num, free_frame);
+        int frame_number = free_frame->frame_number;
+        ref_bits[frame_number] = false;
 
-            // Age the frame we just considered
-            age_frame(potential_victim_frame);
-            unsigned int potential_victim_age = potential_victim_frame->age;
-            if (a)
-            {
-                printf("%d:%X ", potential_victim_frame->frame_number, potential_victim_frame->age);
-            }
+        if (in_b1)
+        {
+            p = std::min(NUM_FRAMES, p + std::max(1u, B2.size() / B1.size()));
+            B1.remove(fault_key);
+            T2.push_back(frame_number);
+        }
+        else if (in_b2)
+        {
+            unsigned int delta = std::max(1u, B1.size() / B2.size());
+            p = p > delta ? p - delta : 0;
+            B2.remove(fault_key);
+            T2.push_back(frame_number);
+        }
+        else
+        {
+            T1.push_back(frame_number);
+        }
+        in_b1 = in_b2 = false;
+    }
 
-            // If this is the first, it counts as the youngest (temporarily)
-            if (youngest_age == 0)
+    void reference_frame(unsigned int frame_number)
+    {
+        ref_bits[frame_number] = true;
+    }
+
+    void clear_mapping(int frame_number)
+    {
+        T1.remove(frame_number);
+        T2.remove(frame_number);
+        Pager::clear_mapping(frame_number);
+    }
+
+private:
+    FrameList T1;
+    FrameList T2;
+    GhostList B1;
+    GhostList B2;
+    std::vector<bool> ref_bits;
+    unsigned int p = 0;
+    uint64_t fault_key = 0;
+    bool in_b1 = false;
+    bool in_b2 = false;
+
+    // Sweeps the T1 / T2 clocks until an unreferenced page is found
+    int replace()
+    {
+        while (true)
+        {
+            query_len++;
+            if (!T1.empty() && (T1.size() >= std::max(1u, p) || T2.empty()))
             {
-                youngest_age = potential_victim_age;
-                temp_youngest = potential_victim_frame;
+                int head = T1.front();
+                T1.remove(head);
+                if (!ref_bits[head])
+                {
+                    B1.push_front(frame_key(head));
+                    return head;
+                }
+                // Referenced again while in T1 -> it is frequent
+                ref_bits[head] = false;
+                T2.push_back(head);
             }
             else
             {
-                // Update youngest found if current is younger
-                if (potential_victim_age < youngest_age)
+                int head = T2.front();
+                T2.remove(head);
+                if (!ref_bits[head])
                 {
-                    youngest_age = potential_victim_age;
-                    temp_youngest = potential_victim_frame;
+                    B2.push_front(frame_key(head));
+                    return head;
                 }
+                ref_bits[head] = false;
+                T2.push_back(head);
             }
+        }
+    }
 
-            // Keep searching
-            increment_clock_hand();
-            query_len++;
+    inline uint64_t frame_key(int frame_number)
+    {
+        return page_key(FRAME_TABLE[frame_number].process_id, FRAME_TABLE[frame_number].VMA_page_number);
+    }
+};
+
+// Low Inter-reference Recency Set (Jiang & Zhang)
+// Stack S orders LIR pages, resident HIR pages and non resident HIR pages by
+// recency (front = top), queue Q holds resident HIR pages (front = next victim).
+// A HIR page referenced again while still in S has a smaller reuse distance
+// than the bottom LIR page, so they swap status.
+// Non resident history is capped at NONRESIDENT_RATIO * NUM_FRAMES entries,
+// all entries come from a pool sized once in the constructor.
+class LIRS_Pager : Pager
+{
+public:
+    LIRS_Pager(int NUM_FRAMES, bool O, bool a) : Pager(LIRS, NUM_FRAMES, O, a)
+    {
+        tracks_references = true;
+        unsigned int num_frames = NUM_FRAMES;
+        max_nonresident = NONRESIDENT_RATIO * num_frames;
+        unsigned int hir_frames = std::max(1u, num_frames / 100);
+        max_lir = num_frames > hir_frames ? num_frames - hir_frames : 0;
+
+        // Resident pages + non resident history + one in flight
+        unsigned int pool_size = num_frames + max_nonresident + 1;
+        entries.resize(pool_size);
+        for (int i = pool_size - 1; i >= 0; i--)
+        {
+            free_entries.push_back(i);
         }
+        index.init(pool_size);
+        stack.init(pool_size);
+        queue.init(pool_size);
+        nonresident.init(pool_size);
+        frame_entry.assign(NUM_FRAMES, NIL);
+    };
 
-        free_frame = temp_youngest;
-        // Reset clock hand and return free frame
-        CLOCK_HAND = free_frame->frame_number;
-        increment_clock_hand();
+    frame_t *select_victim_frame()
+    {
+        // Resident HIR pages are evicted first, LIR only if there are none
+        int victim = queue.empty() ? stack.back() : queue.front();
+        queue.remove(victim);
+        int frame_number = entries[victim].frame;
+        frame_entry[frame_number] = NIL;
+        entries[victim].frame = NIL;
+
+        if (entries[victim].lir)
+        {
+            entries[victim].lir = false;
+            lir_count--;
+            stack.remove(victim);
+            release(victim);
+            prune();
+        }
+        else if (stack.contains(victim))
+        {
+            // Keep as non resident HIR history while it's still in S
+            nonresident.push_front(victim);
+            bound_nonresident();
+        }
+        else
+        {
+            release(victim);
+        }
 
+        frame_t *free_frame = &FRAME_TABLE[frame_number];
         if (a)
         {
-            printf("| %d\n", free_frame->frame_number);
+            printf("ASELECT %d | LIR=%u HIR=%u NR=%u\n", free_frame->frame_number, lir_count, queue.size(), nonresident.size());
         }
-
         return free_frame;
-    };
+    }
 
     void map_frame(Process *process, int vpage_num, frame_t *free_frame)
     {
-        // Reset Age every MAP operation
-        free_frame->age = 0;
-
         Pager::map_frame(process, vpage_num, free_frame);
+        int frame_number = free_frame->frame_number;
+        uint64_t key = page_key(process->get_pid(), vpage_num);
+        int entry = index.find(key);
+
+        if (entry != NIL)
+        {
+            // Non resident HIR page still in S: its reuse distance beats the bottom LIR page
+            nonresident.remove(entry);
+            stack.remove(entry);
+            stack.push_front(entry);
+            attach(entry, frame_number);
+            make_lir(entry);
+            return;
+        }
+
+        entry = acquire(key);
+        attach(entry, frame_number);
+        stack.push_front(entry);
+        if (lir_count < max_lir)
+        {
+            // Warm up: fill the LIR set first
+            entries[entry].lir = true;
+            lir_count++;
+        }
+        else
+        {
+            queue.push_back(entry);
+        }
     }
 
-    void unmap_frame(unsigned int pid, unsigned int old_page_num)
+    void reference_frame(unsigned int frame_number)
     {
-        Pager::unmap_frame(pid, old_page_num);
+        int entry = frame_entry[frame_number];
+        if (entries[entry].lir)
+        {
+            bool was_bottom = stack.back() == entry;
+            stack.remove(entry);
+            stack.push_front(entry);
+            if (was_bottom)
+            {
+                prune();
+            }
+        }
+        else if (stack.contains(entry))
+        {
+            stack.remove(entry);
+            stack.push_front(entry);
+            queue.remove(entry);
+            make_lir(entry);
+        }
+        else
+        {
+            stack.push_front(entry);
+            queue.remove(entry);
+            queue.push_back(entry);
+        }
     }
 
-private:
-    void age_frame(frame_t *potential_victim_frame)
+    void clear_mapping(int frame_number)
     {
-        // Get VPAGE
-        Process *temp = &process_arr[potential_victim_frame->process_id];
-        pte_t *page = temp->get_vpage(potential_victim_frame->VMA_page_number);
+        // Frames released on process exit drop their page entirely
+        int entry = frame_entry[frame_number];
+        if (entry != NIL)
+        {
+            frame_entry[frame_number] = NIL;
+            if (entries[entry].lir)
+            {
+                lir_count--;
+            }
+            stack.remove(entry);
+            queue.remove(entry);
+            release(entry);
+            prune();
+        }
+        Pager::clear_mapping(frame_number);
+    }
 
-        // Shift Right
-        shift_age_right(potential_victim_frame);
+    void frame_owner_changed(int frame_number)
+    {
+        int entry = frame_entry[frame_number];
+        uint64_t key = page_key(FRAME_TABLE[frame_number].process_id, FRAME_TABLE[frame_number].VMA_page_number);
+        int stale = index.find(key);
+        if (stale != NIL)
+        {
+            // Non resident history of the new owner's page is superseded
+            nonresident.remove(stale);
+            stack.remove(stale);
+            release(stale);
+        }
+        index.erase(entries[entry].key);
+        entries[entry].key = key;
+        index.insert(key, entry);
+    }
 
-        // Add R bit to leading
-        if (page->REFERENCED)
+private:
+    typedef struct lirs_entry
+    {
+        uint64_t key = 0;
+        int frame = -1;
+        bool lir = false;
+    } lirs_entry;
+
+    const int NIL = -1;
+    const unsigned int NONRESIDENT_RATIO = 2;
+    unsigned int max_nonresident;
+    unsigned int max_lir;
+    unsigned int lir_count = 0;
+    std::vector<lirs_entry> entries;
+    std::vector<int> free_entries;
+    std::vector<int> frame_entry;
+    PageKeyMap index;
+    FrameList stack;
+    FrameList queue;
+    FrameList nonresident;
+
+    int acquire(uint64_t key)
+    {
+        if (free_entries.empty())
         {
-            set_leading_bit_to_one(potential_victim_frame);
+            drop_oldest_nonresident();
         }
-        // If its 1, must be reset to 0
-        page->REFERENCED = 0;
+        int entry = free_entries.back();
+        free_entries.pop_back();
+        entries[entry].key = key;
+        entries[entry].frame = NIL;
+        entries[entry].lir = false;
+        index.insert(key, entry);
+        return entry;
     }
 
-    inline void set_leading_bit_to_one(frame_t *frame)
+    void release(int entry)
     {
-        frame->age = frame->age | 0x80000000;
+        index.erase(entries[entry].key);
+        free_entries.push_back(entry);
     }
 
-    inline void shift_age_right(frame_t *frame)
+    inline void attach(int entry, int frame_number)
     {
-        frame->age = frame->age >> 1;
+        entries[entry].frame = frame_number;
+        frame_entry[frame_number] = entry;
     }
 
-    void increment_clock_hand()
+    // Promotes entry (already on top of S) to LIR, demoting the bottom LIR page if the set is full
+    void make_lir(int entry)
     {
-        CLOCK_HAND++;
-        if (CLOCK_HAND >= NUM_FRAMES)
+        entries[entry].lir = true;
+        lir_count++;
+        if (lir_count > max_lir)
         {
-            CLOCK_HAND = 0;
+            // Bottom of S is only guaranteed LIR after pruning
+            prune();
+            int bottom = stack.back();
+            entries[bottom].lir = false;
+            lir_count--;
+            stack.remove(bottom);
+            queue.push_back(bottom);
+            prune();
+        }
+    }
+
+    // Removes HIR entries from the bottom of S until a LIR page is at the bottom
+    void prune()
+    {
+        while (!stack.empty() && !entries[stack.back()].lir)
+        {
+            int bottom = stack.back();
+            stack.remove(bottom);
+            if (entries[bottom].frame == NIL)
+            {
+                nonresident.remove(bottom);
+                release(bottom);
+            }
+        }
+    }
+
+    void bound_nonresident()
+    {
+        while (nonresident.size() > max_nonresident)
+        {
+            drop_oldest_nonresident();
         }
     }
+
+    void drop_oldest_nonresident()
+    {
+        int oldest = nonresident.back();
+        nonresident.remove(oldest);
+        stack.remove(oldest);
+        release(oldest);
+    }
 };
 
-class Working_Set_Pager : Pager
+// CLOCK-Pro (Jiang, Chen & Zhang): LIRS approximated with a single clock.
+// Resident pages are hot or cold, recently evicted cold pages stay on the
+// clock as non resident "test" pages. HAND_cold evicts, HAND_hot demotes and
+// HAND_test ends test periods; a test page faulting back in becomes hot and
+// grows the cold target. At most NUM_FRAMES test pages are kept and all
+// entries come from a pool sized once in the constructor.
+class ClockPro_Pager : Pager
 {
 public:
-    Working_Set_Pager(int NUM_FRAMES, bool O, bool a) : Pager(Working_Set, NUM_FRAMES, O, a){};
+    ClockPro_Pager(int NUM_FRAMES, bool O, bool a) : Pager(CLOCK_Pro, NUM_FRAMES, O, a)
+    {
+        tracks_references = true;
+        // Start out like LIRS with ~1% of memory for cold pages, test page re-faults grow it
+        unsigned int num_frames = NUM_FRAMES;
+        cold_target = std::max(1u, num_frames / 100);
+
+        // Resident pages + test pages + one in flight
+        unsigned int pool_size = 2 * num_frames + 2;
+        entries.resize(pool_size);
+        for (int i = pool_size - 1; i >= 0; i--)
+        {
+            free_entries.push_back(i);
+        }
+        index.init(pool_size);
+        clock.init(pool_size);
+        frame_entry.assign(NUM_FRAMES, NIL);
+    };
 
     frame_t *select_victim_frame()
     {
-        // Helper vars
-        frame_t *free_frame = nullptr;
-        int start_hand_pos = CLOCK_HAND;
         query_len = 0;
+        evicted = NIL;
+        while (evicted == NIL)
+        {
+            run_cold();
+        }
 
-        // Keep track of candidate victim frames
-        frame_t *oldest_class_one_frame = nullptr;
-        frame_t *oldest_class_two_frame = nullptr;
-        unsigned int oldest_class_one_age = 0;
-        unsigned int oldest_class_two_age = 0;
-
-        // Option for verbose output
+        frame_t *free_frame = &FRAME_TABLE[evicted];
         if (a)
         {
-            if (start_hand_pos == 0)
-            {
-                printf("ASELECT %d-%d | ", start_hand_pos, NUM_FRAMES - 1);
-            }
-            else
-            {
-                printf("ASELECT %d-%d | ", start_hand_pos, start_hand_pos - 1);
-            }
+            printf("ASELECT %d %d | hot=%u cold=%u test=%u target=%u\n", free_frame->frame_number, query_len, count_hot, count_cold, count_test, cold_target);
         }
+        return free_frame;
+    }
 
-        // Begin our search for our victim frame
-        while (!free_frame)
+    void map_frame(Process *process, int vpage_num, frame_t *free_frame)
+    {
+        Pager::map_frame(process, vpage_num, free_frame);
+        int frame_number = free_frame->frame_number;
+        uint64_t key = page_key(process->get_pid(), vpage_num);
+        int entry = index.find(key);
+
+        if (entry != NIL)
         {
-            // Make sure we only visit each frame only once
-            if (start_hand_pos == CLOCK_HAND && (query_len > 0))
+            // Faulted back in during its test period -> hot, more room for cold pages
+            if (cold_target < NUM_FRAMES)
             {
-                break;
+                cold_target++;
             }
+            count_test--;
+            unlink(entry);
+            entries[entry].type = HOT;
+            count_hot++;
+        }
+        else
+        {
+            entry = acquire(key);
+            entries[entry].type = COLD;
+            count_cold++;
+        }
+        entries[entry].ref = false;
+        entries[entry].frame = frame_number;
+        frame_entry[frame_number] = entry;
+        link_at_head(entry);
+    }
 
-            // Helper variables
-            frame_t *potential_victim_frame = &FRAME_TABLE[CLOCK_HAND];
-            Process *temp_proc = &process_arr[potential_victim_frame->process_id];
-            pte_t *page = temp_proc->get_vpage(potential_victim_frame->VMA_page_number);
+    void reference_frame(unsigned int frame_number)
+    {
+        entries[frame_entry[frame_number]].ref = true;
+    }
 
-            // Verbose output print options
-            if (a)
+    void clear_mapping(int frame_number)
+    {
+        // Frames released on process exit drop their page entirely
+        int entry = frame_entry[frame_number];
+        if (entry != NIL)
+        {
+            frame_entry[frame_number] = NIL;
+            if (entries[entry].type == HOT)
             {
-                printf("%d(%d %d:%d %d) ", CLOCK_HAND, page->REFERENCED, potential_victim_frame->process_id,
-                       potential_victim_frame->VMA_page_number, potential_victim_frame->age);
+                count_hot--;
             }
-
-            // Check if we've found a frame with class = 0
-            // Class = 0 means frame age >= TAU and REF = 0
-            if (is_class_zero(page, potential_victim_frame))
+            else
             {
-                free_frame = potential_victim_frame;
-                if (a)
-                {
-                    printf("STOP(%d) ", query_len);
-                }
+                count_cold--;
+            }
+            unlink(entry);
+            release(entry);
+        }
+        Pager::clear_mapping(frame_number);
+    }
 
-                break;
+    void frame_owner_changed(int frame_number)
+    {
+        int entry = frame_entry[frame_number];
+        uint64_t key = page_key(FRAME_TABLE[frame_number].process_id, FRAME_TABLE[frame_number].VMA_page_number);
+        int stale = index.find(key);
+        if (stale != NIL)
+        {
+            // Test period of the new owner's page is superseded
+            count_test--;
+            unlink(stale);
+            release(stale);
+        }
+        index.erase(entries[entry].key);
+        entries[entry].key = key;
+        index.insert(key, entry);
+    }
+
+private:
+    enum CLOCK_PRO_TYPES
+    {
+        HOT,
+        COLD,
+        TEST
+    };
+
+    typedef struct clock_pro_entry
+    {
+        uint64_t key = 0;
+        int frame = -1;
+        CLOCK_PRO_TYPES type = COLD;
+        bool ref = false;
+    } clock_pro_entry;
+
+    const int NIL = -1;
+    std::vector<clock_pro_entry> entries;
+    std::vector<int> free_entries;
+    std::vector<int> frame_entry;
+    PageKeyMap index;
+    FrameList clock;
+    int hand_hot = -1;
+    int hand_cold = -1;
+    int hand_test = -1;
+    unsigned int count_hot = 0;
+    unsigned int count_cold = 0;
+    unsigned int count_test = 0;
+    unsigned int cold_target;
+    int evicted = -1;
+
+    void run_cold()
+    {
+        query_len++;
+        int entry = hand_cold;
+        if (entries[entry].type == COLD)
+        {
+            if (entries[entry].ref)
+            {
+                // Re-referenced while cold -> hot
+                entries[entry].type = HOT;
+                entries[entry].ref = false;
+                count_cold--;
+                count_hot++;
             }
             else
             {
-                // Otherwise get frame class and decide what to do
-                WS_FRAME_CLASSES frame_class = get_frame_ws_class(page, potential_victim_frame);
-
-                switch (frame_class)
+                // Evict, keep it on the clock as a test page
+                evicted = entries[entry].frame;
+                frame_entry[evicted] = NIL;
+                entries[entry].frame = NIL;
+                entries[entry].type = TEST;
+                count_cold--;
+                count_test++;
+                while (count_test > NUM_FRAMES)
                 {
-                // Class 1: A unreferenced page with age < TAU
-                case WS_CLASS_1:
-                    // If this is the first frame we've seen of this class, by default it is the oldest
-                    if (oldest_class_one_age == 0)
-                    {
-                        oldest_class_one_age = potential_victim_frame->age;
-                        oldest_class_one_frame = potential_victim_frame;
-                    }
-                    else
-                    {
-                        // Otherwise, check if oldest needs to be updated
-                        if (potential_victim_frame->age < oldest_class_one_age)
-                        {
-                            oldest_class_one_age = potential_victim_frame->age;
-                            oldest_class_one_frame = potential_victim_frame;
-                        }
-                    }
-                    break;
-
-                // Class 2, a referenced page
-                case WS_CLASS_2:
-                    if (!oldest_class_two_frame)
-                    {
-                        oldest_class_two_age = potential_victim_frame->age;
-                        oldest_class_two_frame = potential_victim_frame;
-                    }
-
-                    // Reset R bit and set age
-                    mark_frame_and_page(page, potential_victim_frame);
-                    break;
+                    run_test();
                 }
             }
-
-            // Keep track of how many frames we're visiting / move hand
-            query_len++;
-            increment_clock_hand();
         }
+        hand_cold = advance(hand_cold);
+        while (count_hot > NUM_FRAMES - cold_target)
+        {
+            run_hot();
+        }
+    }
 
-        // If we didn't find a frame in the loop, then we select the youngest
-        if (!free_frame)
+    void run_hot()
+    {
+        if (hand_hot == hand_test)
+        {
+            run_test();
+        }
+        int entry = hand_hot;
+        if (entries[entry].type == HOT)
         {
-            if (oldest_class_one_frame)
+            if (entries[entry].ref)
             {
-                free_frame = oldest_class_one_frame;
+                entries[entry].ref = false;
             }
             else
             {
-                free_frame = oldest_class_two_frame;
+                entries[entry].type = COLD;
+                count_hot--;
+                count_cold++;
             }
         }
+        hand_hot = advance(hand_hot);
+    }
 
-        // Set clock hand back to appropriate spot
-        CLOCK_HAND = free_frame->frame_number;
-        increment_clock_hand();
-        if (a)
+    void run_test()
+    {
+        int entry = hand_test;
+        hand_test = advance(hand_test);
+        if (entries[entry].type == TEST)
         {
-            printf("| %d\n", free_frame->frame_number);
+            // Test period over without a re-fault -> fewer cold pages needed
+            count_test--;
+            unlink(entry);
+            release(entry);
+            if (cold_target > 1)
+            {
+                cold_target--;
+            }
         }
-
-        return free_frame;
     }
 
-    void map_frame(Process *process, int vpage_num, frame_t *free_frame)
+    inline int advance(int hand)
     {
-        // When mapping a frame set its age to instruction count
-        // -1 as inst_count is incremented before frames are allocated
-        // due to the accounting i've set up with billing read/writes
-        free_frame->age = inst_count - 1;
-
-        Pager::map_frame(process, vpage_num, free_frame);
+        int next = clock.next_of(hand);
+        return next == NIL ? clock.front() : next;
     }
 
-private:
-    const unsigned int TAU = 49;
-
-    // Helper function to determine if page belongs to class 0
-    bool is_class_zero(pte_t *page, frame_t *frame)
+    // New pages go right behind HAND_hot, the last position any hand reaches
+    void link_at_head(int entry)
     {
-        if ((!page->REFERENCED) && (inst_count - frame->age - 1) > TAU)
+        if (clock.empty())
         {
-            return true;
+            clock.push_back(entry);
+            hand_hot = hand_cold = hand_test = entry;
+            return;
         }
-        return false;
+        clock.insert_before(hand_hot, entry);
     }
 
-    // Helper function to get class of frame
-    WS_FRAME_CLASSES get_frame_ws_class(pte_t *page, frame_t *frame)
+    void unlink(int entry)
     {
-        if (page->REFERENCED)
+        if (clock.size() == 1)
+        {
+            clock.remove(entry);
+            hand_hot = hand_cold = hand_test = NIL;
+            return;
+        }
+        int next = advance(entry);
+        if (hand_hot == entry)
+        {
+            hand_hot = next;
+        }
+        if (hand_cold == entry)
+        {
+            hand_cold = next;
+        }
+        if (hand_test == entry)
         {
-            return WS_CLASS_2;
+            hand_test = next;
         }
-        return WS_CLASS_1;
+        clock.remove(entry);
     }
 
-    // Helper function to reset REF bit and set age
-    inline void mark_frame_and_page(pte_t *page, frame_t *frame)
+    int acquire(uint64_t key)
     {
-        page->REFERENCED = 0;
-        // -1 as count gets incremented on read/write allocation before frame is allocated
-        frame->age = inst_count - 1;
+        int entry = free_entries.back();
+        free_entries.pop_back();
+        entries[entry].key = key;
+        index.insert(key, entry);
+        return entry;
+    }
+
+    void release(int entry)
+    {
+        index.erase(entries[entry].key);
+        free_entries.push_back(entry);
     }
 };
 
@@ -1022,6 +3227,65 @@ Pager *build_pager(PAGER_TYPES pager_type, int NUM_FRAMES, int array_size, int *
         return (Pager *)new Aging_Pager(NUM_FRAMES, O, a);
     case Working_Set:
         return (Pager *)new Working_Set_Pager(NUM_FRAMES, O, a);
+    case LRU:
+        return (Pager *)new LRU_Pager(NUM_FRAMES, O, a);
+    case ARC:
+        return (Pager *)new ARC_Pager(NUM_FRAMES, O, a);
+    case CAR:
+        return (Pager *)new CAR_Pager(NUM_FRAMES, O, a);
+    case LIRS:
+        return (Pager *)new LIRS_Pager(NUM_FRAMES, O, a);
+    case CLOCK_Pro:
+        return (Pager *)new ClockPro_Pager(NUM_FRAMES, O, a);
+    }
+}
+
+// Memory model options applied on top of any pager
+typedef struct pager_options
+{
+    tlb_config tlb_geometry;
+    unsigned int huge_order;
+    bool buddy;
+    local_config local;
+    writeback_config writeback;
+    prefetch_config prefetch;
+    zswap_config zswap;
+} pager_options;
+
+void configure_pager(Pager *pager, const pager_options &options)
+{
+    if (options.writeback.interval)
+    {
+        pager->use_writeback_daemon(options.writeback);
+    }
+    pager->use_local_replacement(options.local);
+    if (options.buddy)
+    {
+        pager->use_buddy_allocator();
+    }
+    if (options.tlb_geometry.entries)
+    {
+        pager->attach_tlb(new Tlb(options.tlb_geometry));
+    }
+    pager->enable_huge_pages(options.huge_order);
+    if (options.prefetch.mode != NO_PREFETCH)
+    {
+        pager->attach_prefetcher(build_prefetcher(options.prefetch));
+    }
+}
+
+// Builds a pager with the options applied. A compressed pool takes its frames
+// off num_frames, the replacement policy manages the rest.
+Pager *build_configured_pager(PAGER_TYPES pager_type, unsigned int num_frames, int array_size, int *randvals, bool O, bool a, const pager_options &options)
+{
+    check_frame_count(num_frames);
+    unsigned int pool_frames = options.zswap.percent ? zswap_pool_frames(options.zswap, num_frames) : 0;
+    Pager *pager = build_pager(pager_type, num_frames - pool_frames, array_size, randvals, O, a);
+    configure_pager(pager, options);
+    if (pool_frames)
+    {
+        pager->attach_zswap(new CompressedPool(pool_frames, options.zswap));
     }
+    return pager;
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,244 @@
+#include "data_structures.hpp"
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef PREFETCH
+#define PREFETCH
+
+enum PREFETCH_MODES
+{
+    NO_PREFETCH,
+    SEQUENTIAL_PREFETCH,
+    STRIDE_PREFETCH,
+    CLUSTER_PREFETCH
+};
+
+// Read-ahead policy, degree is the max window (seq), pages per stride (stride) or cluster size (cluster)
+typedef struct prefetch_config
+{
+    PREFETCH_MODES mode;
+    unsigned int degree;
+} prefetch_config;
+
+// Parses "seq[:max_window]", "stride[:degree]" or "cluster[:pages]"
+prefetch_config parse_prefetch_config(const std::string &spec)
+{
+    prefetch_config config = {NO_PREFETCH, 0};
+    char mode[16] = {0};
+    int n = sscanf(spec.c_str(), "%15[^:]:%u", mode, &config.degree);
+    std::string name(mode);
+    if (name == "seq")
+    {
+        config.mode = SEQUENTIAL_PREFETCH;
+        config.degree = n == 2 ? config.degree : 16;
+    }
+    else if (name == "stride")
+    {
+        config.mode = STRIDE_PREFETCH;
+        config.degree = n == 2 ? config.degree : 4;
+    }
+    else if (name == "cluster")
+    {
+        config.mode = CLUSTER_PREFETCH;
+        config.degree = n == 2 ? config.degree : 8;
+    }
+    if (config.mode == NO_PREFETCH || config.degree == 0 || config.degree >= NUM_PTE ||
+        (config.mode == CLUSTER_PREFETCH && (config.degree & (config.degree - 1))))
+    {
+        throw std::invalid_argument("Invalid prefetch config (seq[:max] / stride[:degree] / cluster[:pages, power of 2]): " + spec);
+    }
+    return config;
+}
+
+/* Read-ahead policies. A prefetcher is trained on the demand fault stream
+   plus the first touch of every prefetched page (a prefetch hit), i.e. on
+   every access that would have faulted without read-ahead, and proposes
+   vpages to bring in. The pager filters the proposals: only valid, non
+   present pages with a backing store (file mapped or paged out) are read. */
+class Prefetcher
+{
+public:
+    virtual ~Prefetcher() {}
+
+    // A fault (fault == true) or a prefetch hit on vpage, appends candidate vpages to out
+    virtual void access(Process *process, int vpage, bool fault, std::vector<int> &out) = 0;
+
+    // A prefetched page of pid was evicted / freed without ever being touched
+    virtual void wasted(unsigned int pid){};
+};
+
+// Sequential read-ahead: a stream starts with a window of 2 pages ahead of the
+// access. Each sequential access tops the window up, a sequential fault (the
+// window was too small to hide the stream) doubles it up to max_window and a
+// wasted page halves it. A non sequential fault drops the stream.
+class Sequential_Prefetcher : public Prefetcher
+{
+public:
+    Sequential_Prefetcher(unsigned int max_window_)
+    {
+        max_window = max_window_;
+    }
+
+    void access(Process *process, int vpage, bool fault, std::vector<int> &out)
+    {
+        stream_t &stream = stream_of(process->get_pid());
+        if (vpage == stream.last + 1)
+        {
+            if (!stream.window)
+            {
+                stream.window = std::min(2u, max_window);
+            }
+            else if (fault)
+            {
+                stream.window = std::min(stream.window * 2, max_window);
+            }
+            int from = std::max(stream.ahead, vpage + 1);
+            int to = vpage + (int)stream.window;
+            for (int page = from; page <= to; page++)
+            {
+                out.push_back(page);
+            }
+            stream.ahead = std::max(stream.ahead, to + 1);
+        }
+        else if (fault)
+        {
+            stream.window = 0;
+            stream.ahead = 0;
+        }
+        stream.last = vpage;
+    }
+
+    void wasted(unsigned int pid)
+    {
+        stream_t &stream = stream_of(pid);
+        stream.window /= 2;
+    }
+
+private:
+    typedef struct stream_t
+    {
+        int last = -2;
+        // First page past everything read ahead so far
+        int ahead = 0;
+        unsigned int window = 0;
+    } stream_t;
+
+    unsigned int max_window;
+    std::vector<stream_t> streams;
+
+    stream_t &stream_of(unsigned int pid)
+    {
+        if (pid >= streams.size())
+        {
+            streams.resize(pid + 1);
+        }
+        return streams[pid];
+    }
+};
+
+// Per process stride detection: once the same non zero stride was seen twice in
+// a row, the next degree pages along the stride are read ahead
+class Stride_Prefetcher : public Prefetcher
+{
+public:
+    Stride_Prefetcher(unsigned int degree_)
+    {
+        degree = degree_;
+    }
+
+    void access(Process *process, int vpage, bool fault, std::vector<int> &out)
+    {
+        stride_t &state = state_of(process->get_pid());
+        int stride = vpage - state.last;
+        if (state.last >= 0 && stride != 0 && stride == state.stride)
+        {
+            state.confidence = std::min(state.confidence + 1, 3);
+        }
+        else
+        {
+            state.stride = stride;
+            state.confidence = 0;
+        }
+        state.last = vpage;
+        if (state.confidence > 0)
+        {
+            for (unsigned int k = 1; k <= degree; k++)
+            {
+                out.push_back(vpage + (int)k * state.stride);
+            }
+        }
+    }
+
+    void wasted(unsigned int pid)
+    {
+        stride_t &state = state_of(pid);
+        state.confidence = std::max(state.confidence - 1, 0);
+    }
+
+private:
+    typedef struct stride_t
+    {
+        int last = -1;
+        int stride = 0;
+        int confidence = 0;
+    } stride_t;
+
+    unsigned int degree;
+    std::vector<stride_t> states;
+
+    stride_t &state_of(unsigned int pid)
+    {
+        if (pid >= states.size())
+        {
+            states.resize(pid + 1);
+        }
+        return states[pid];
+    }
+};
+
+// File mapped read-around: a fault on a file mapped page reads the whole
+// aligned cluster of pages around it (like mmap read-around / page_cluster)
+class Cluster_Prefetcher : public Prefetcher
+{
+public:
+    Cluster_Prefetcher(unsigned int cluster_pages_)
+    {
+        cluster_pages = cluster_pages_;
+    }
+
+    void access(Process *process, int vpage, bool fault, std::vector<int> &out)
+    {
+        const vma_range *vma = process->find_vma(vpage);
+        if (!fault || !vma || !vma->FILEMAPPED)
+        {
+            return;
+        }
+        int first = vpage & ~(int)(cluster_pages - 1);
+        for (int page = first; page < first + (int)cluster_pages; page++)
+        {
+            out.push_back(page);
+        }
+    }
+
+private:
+    unsigned int cluster_pages;
+};
+
+Prefetcher *build_prefetcher(const prefetch_config &config)
+{
+    switch (config.mode)
+    {
+    case SEQUENTIAL_PREFETCH:
+        return new Sequential_Prefetcher(config.degree);
+    case STRIDE_PREFETCH:
+        return new Stride_Prefetcher(config.degree);
+    case CLUSTER_PREFETCH:
+        return new Cluster_Prefetcher(config.degree);
+    default:
+        return nullptr;
+    }
+}
+
+#endif
@@ -0,0 +1,217 @@
+#include "data_structures.hpp"
+#include "mmu_pagers.hpp"
+
+#ifndef SIMULATION
+#define SIMULATION
+
+void read_write_logic(Pager *THE_PAGER, Process *CURRENT_PROCESS, const int vpage)
+{
+    // Add Read/Write cycle cost to pager for accounting
+    THE_PAGER->allocate_cost(READ_WRITE);
+
+    // Only a TLB miss walks the page table
+    bool tlb_hit = THE_PAGER->tlb_lookup(CURRENT_PROCESS, vpage);
+    if (!tlb_hit)
+    {
+        CURRENT_PROCESS->count_page_walk(vpage);
+    }
+
+    // Read-ahead may have had to evict the page itself, its TLB entry is gone then
+    if (THE_PAGER->read_ahead(CURRENT_PROCESS, vpage))
+    {
+        tlb_hit = tlb_hit && CURRENT_PROCESS->check_present_valid(vpage);
+    }
+
+    if (!CURRENT_PROCESS->check_present_valid(vpage))
+    {
+        // Page fault logic
+        if (!CURRENT_PROCESS->vpage_can_be_accessed(vpage))
+        {
+            // Allocate cost of a segmentation violation
+            CURRENT_PROCESS->allocate_cost(SEGV);
+            THE_PAGER->trace(TRACE_SEGV);
+            return;
+        }
+        else
+        {
+            // Page can be accessed, so it must be allocated
+            THE_PAGER->count_fault();
+            THE_PAGER->profile_fault_begin(CURRENT_PROCESS);
+            THE_PAGER->page_fault(CURRENT_PROCESS, vpage);
+            frame_t *frame = THE_PAGER->get_frame(CURRENT_PROCESS, vpage);
+
+            // See if the frame is coming from free frames or victim frames
+            if (frame->process_id != -1)
+            {
+                // Unmap Victim Frame
+                THE_PAGER->unmap_frame(frame->process_id, frame->VMA_page_number);
+            }
+
+            // Update referenced bit, frame number on VPage
+            THE_PAGER->map_frame(CURRENT_PROCESS, vpage, frame);
+            THE_PAGER->try_promote(CURRENT_PROCESS, vpage);
+            THE_PAGER->profile_fault_end(CURRENT_PROCESS, vpage);
+        }
+    }
+    else if (THE_PAGER->tracks_references)
+    {
+        // Hit on a present page, let recency based pagers see it
+        THE_PAGER->reference_frame(CURRENT_PROCESS->get_frame_num(vpage));
+    }
+
+    // The page is present now, cache its translation
+    if (!tlb_hit)
+    {
+        THE_PAGER->tlb_fill(CURRENT_PROCESS, vpage);
+    }
+}
+
+// Simulation state carried from one instruction to the next
+typedef struct sim_state
+{
+    Pager *THE_PAGER;
+    Process *process_arr;
+    Process *CURRENT_PROCESS;
+    int current_process_num;
+    unsigned long inst_count;
+    // Structured time series, nullptr = none
+    StructuredWriter *output;
+} sim_state;
+
+// Executes a single parsed instruction against the pager / current process
+void execute_instruction(sim_state *state, char operation, int vpage)
+{
+    // If O option print instruction details
+    if ((operation == 'c' || operation == 'w' || operation == 'e' || operation == 'r' || operation == 'f'))
+    {
+        state->THE_PAGER->trace(TRACE_INSTRUCTION, state->inst_count, operation, vpage);
+        state->inst_count++;
+    }
+
+    switch (operation)
+    {
+    case 'c':
+        // Update current process number
+        state->current_process_num = vpage;
+        // Add context-switching cycle cost to pager for accounting
+        state->THE_PAGER->allocate_cost(CONTEXT_SWITCH);
+        // Update the pointer to current Process
+        state->CURRENT_PROCESS = &state->process_arr[state->current_process_num];
+        state->THE_PAGER->tlb_context_switch();
+        break;
+
+    case 'e':
+        // Add Process-Exit cycle cost to pager for accounting
+        state->THE_PAGER->allocate_cost(PROC_EXIT);
+        state->THE_PAGER->trace(TRACE_EXIT, state->current_process_num);
+
+        // Traverse active process page table, each valid entry unmap the page
+        // (only allocated leaves can hold valid entries)
+        state->CURRENT_PROCESS->for_each_pte([state](int i, pte_t *temp)
+                                             {
+            if (temp->PRESENT)
+            {
+                // A frame some forked process still maps stays resident, and dirty, for it
+                bool shared = state->THE_PAGER->drop_shared_mapping(state->CURRENT_PROCESS, i);
+                if (shared)
+                {
+                    temp->MODIFIED = 0;
+                }
+
+                state->THE_PAGER->trace(TRACE_UNMAP, state->current_process_num, i);
+                if (temp->FILEMAPPED && temp->MODIFIED)
+                {
+                    state->THE_PAGER->trace(TRACE_FOUT);
+                    state->THE_PAGER->profile_writeback(state->current_process_num, i);
+                }
+
+                // Unmap frame
+                unsigned int frame_num = temp->frame_number;
+                if (!shared)
+                {
+                    state->THE_PAGER->clear_mapping(frame_num);
+
+                    // Add frame to free list
+                    state->THE_PAGER->add_frame_to_free_list(frame_num);
+                }
+
+                // Update accounting per instructions:
+                /*On process exit (instruction), you have to traverse the active process’s pagetable starting from
+                 0..63 and for each valid entry UNMAP the page and FOUT modified filemapped pages.
+                Note that dirty non-fmapped (anonymous) pages are not written back (OUT) as the process exits.*/
+                state->CURRENT_PROCESS->allocate_cost(UNMAPS);
+                if (temp->FILEMAPPED && temp->MODIFIED)
+                {
+                    state->CURRENT_PROCESS->allocate_cost(FOUTS);
+                }
+            } });
+
+        // Reset all pte_t bits to 0 (frees the page table nodes)
+        state->CURRENT_PROCESS->init_set_all_pte_to_zero();
+        state->THE_PAGER->process_exit(state->CURRENT_PROCESS);
+        break;
+    case 'f':
+        // Fork: process vpage gets a copy-on-write copy of the current address space
+        state->THE_PAGER->allocate_cost(FORK);
+        state->THE_PAGER->fork_process(state->CURRENT_PROCESS, vpage);
+        break;
+    case 'z':
+        // Annotation, not an instruction: compressibility of the data written from now on
+        state->THE_PAGER->set_data_compressibility(state->CURRENT_PROCESS, vpage);
+        break;
+    case 'r':
+        // Read instruction logic
+        read_write_logic(state->THE_PAGER, state->CURRENT_PROCESS, vpage);
+        state->CURRENT_PROCESS->set_referenced(vpage);
+        state->THE_PAGER->share_reference(state->CURRENT_PROCESS, vpage);
+        if (state->THE_PAGER->mirrors_rm_bits)
+        {
+            state->THE_PAGER->sync_rm_bits(state->CURRENT_PROCESS, vpage);
+        }
+        break;
+    case 'w':
+        // Write instruction logic
+        read_write_logic(state->THE_PAGER, state->CURRENT_PROCESS, vpage);
+
+        // Check if write protect is enabled, if so raise SEGPROT
+        if (state->CURRENT_PROCESS->write_protect_enabled(vpage))
+        {
+            // Then we raise a SEGPROT error as we cannot write to this VMA
+            state->CURRENT_PROCESS->allocate_cost(SEGPROT);
+            state->THE_PAGER->trace(TRACE_SEGPROT);
+        }
+        else
+        {
+            // Update Modified if written to successfully (into a private copy if it was shared)
+            if (state->CURRENT_PROCESS->check_present_valid(vpage))
+            {
+                state->THE_PAGER->break_cow(state->CURRENT_PROCESS, vpage);
+            }
+            state->CURRENT_PROCESS->set_write(vpage);
+            if (state->CURRENT_PROCESS->check_present_valid(vpage))
+            {
+                state->THE_PAGER->mark_dirty(state->CURRENT_PROCESS, vpage);
+                state->THE_PAGER->note_write(state->CURRENT_PROCESS, vpage);
+            }
+        }
+
+        // Update ref bit
+        state->CURRENT_PROCESS->set_referenced(vpage);
+        state->THE_PAGER->share_reference(state->CURRENT_PROCESS, vpage);
+        if (state->THE_PAGER->mirrors_rm_bits)
+        {
+            state->THE_PAGER->sync_rm_bits(state->CURRENT_PROCESS, vpage);
+        }
+        break;
+    }
+
+    // Background page cleaner runs between instructions
+    state->THE_PAGER->writeback_tick();
+
+    if (state->output && state->output->sample_due(state->inst_count))
+    {
+        state->THE_PAGER->write_interval(*state->output);
+    }
+}
+
+#endif
@@ -0,0 +1,215 @@
+#include "data_structures.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef STACK_DISTANCE
+#define STACK_DISTANCE
+
+/* Mattson stack distance analysis for true LRU.
+   One pass over the instruction stream yields the number of page faults
+   for every frame count 1..MAX_FRAMES at once: a reference at LRU stack
+   depth d hits in every memory of >= d frames and faults in all smaller ones.
+
+   The stack depth of a page is the number of distinct pages touched since
+   its previous reference. Each page's most recent reference time holds a 1
+   in a Fenwick tree indexed by time, so the depth is a suffix sum: O(log M)
+   per reference, where M is the number of distinct (pid, vpage) pairs.
+   The time axis is compacted whenever it fills up so the tree stays O(M).
+   Only pages that have been touched are tracked, so memory follows the
+   working set rather than the address space size.
+
+   Process exits drop the exiting process's pages from the stack. The curve
+   is exact LRU for traces without exits and an approximation with them, as
+   freed frames are no longer charged to the pages that were below them. */
+class StackDistanceAnalyzer
+{
+public:
+    StackDistanceAnalyzer(Process *process_arr_, unsigned int num_processes_)
+    {
+        process_arr = process_arr_;
+        num_processes = num_processes_;
+        process_pages.resize(num_processes);
+
+        // Grows on compaction when live pages fill more than half of it
+        capacity = 4096;
+        tree.assign(capacity + 1, 0);
+        distance_hist.assign(MAX_FRAMES + 1, 0);
+    }
+
+    // Consumes one instruction, same semantics as execute_instruction
+    void process_instruction(char operation, int arg)
+    {
+        switch (operation)
+        {
+        case 'c':
+            current_process_num = arg;
+            break;
+        case 'e':
+            exit_process(current_process_num);
+            break;
+        case 'f':
+            // The child starts out with the parent's VMAs, its pages count as its own
+            process_arr[arg].copy_address_space(process_arr[current_process_num]);
+            break;
+        case 'r':
+        case 'w':
+            // Segmentation violations never occupy a frame
+            if (process_arr[current_process_num].vpage_can_be_accessed(arg))
+            {
+                access(current_process_num, arg);
+            }
+            break;
+        }
+    }
+
+    // faults[f] = faults an LRU pager with f frames would have taken (f = 1..MAX_FRAMES)
+    std::vector<unsigned long long> fault_curve() const
+    {
+        // Suffix sums of the histogram, one pass from the largest memory down
+        std::vector<unsigned long long> faults(MAX_FRAMES + 1, 0);
+        faults[MAX_FRAMES] = cold_misses + deep_misses;
+        for (unsigned int frames = MAX_FRAMES - 1; frames >= 1; frames--)
+        {
+            faults[frames] = faults[frames + 1] + distance_hist[frames + 1];
+        }
+        return faults;
+    }
+
+    // Miss ratio curve: one line per frame count
+    void print_miss_ratio_curve(FILE *out = stdout) const
+    {
+        std::vector<unsigned long long> faults = fault_curve();
+        fprintf(out, "MRC refs=%llu cold=%llu\n", references, cold_misses);
+        for (unsigned int frames = 1; frames <= MAX_FRAMES; frames++)
+        {
+            double ratio = references ? (double)faults[frames] / references : 0.0;
+            fprintf(out, "%u %llu %.6f\n", frames, faults[frames], ratio);
+        }
+    }
+
+private:
+    Process *process_arr;
+    unsigned int num_processes;
+    int current_process_num = 0;
+
+    // Fenwick tree over access times (1 based), 1 marks a page's latest access
+    std::vector<int> tree;
+    size_t capacity;
+    size_t now = 0;
+    size_t live_pages = 0;
+
+    // Latest access time per page_key(pid, vpage), absent = not on the stack
+    std::unordered_map<uint64_t, size_t> last_access;
+    // Pages of each process currently on the stack, exits only walk these
+    std::vector<std::vector<unsigned int> > process_pages;
+
+    // distance_hist[d] = references found at stack depth d (d <= MAX_FRAMES)
+    std::vector<unsigned long long> distance_hist;
+    unsigned long long deep_misses = 0;
+    unsigned long long cold_misses = 0;
+    unsigned long long references = 0;
+
+    void access(unsigned int pid, unsigned int vpage)
+    {
+        references++;
+        if (now == capacity)
+        {
+            compact();
+        }
+
+        std::pair<std::unordered_map<uint64_t, size_t>::iterator, bool> entry =
+            last_access.insert(std::make_pair(page_key(pid, vpage), (size_t)0));
+        if (!entry.second)
+        {
+            size_t previous = entry.first->second;
+            // Distinct pages touched after the previous access, plus the page itself
+            size_t depth = prefix_sum(now) - prefix_sum(previous) + 1;
+            if (depth <= MAX_FRAMES)
+            {
+                distance_hist[depth]++;
+            }
+            else
+            {
+                deep_misses++;
+            }
+            update(previous, -1);
+        }
+        else
+        {
+            cold_misses++;
+            live_pages++;
+            process_pages[pid].push_back(vpage);
+        }
+
+        now++;
+        update(now, 1);
+        entry.first->second = now;
+    }
+
+    // Removes every page of an exiting process from the stack
+    void exit_process(unsigned int pid)
+    {
+        for (size_t i = 0; i < process_pages[pid].size(); i++)
+        {
+            std::unordered_map<uint64_t, size_t>::iterator it = last_access.find(page_key(pid, process_pages[pid][i]));
+            update(it->second, -1);
+            last_access.erase(it);
+            live_pages--;
+        }
+        process_pages[pid].clear();
+    }
+
+    // Renumbers live access times 1..live_pages (order preserved) and rebuilds the tree
+    void compact()
+    {
+        std::vector<std::pair<size_t, uint64_t> > live;
+        live.reserve(live_pages);
+        for (std::unordered_map<uint64_t, size_t>::const_iterator it = last_access.begin(); it != last_access.end(); it++)
+        {
+            live.push_back(std::make_pair(it->second, it->first));
+        }
+        std::sort(live.begin(), live.end());
+
+        // Leave room for at least as many accesses again as there are live pages
+        capacity = std::max(capacity, 2 * live.size());
+        tree.assign(capacity + 1, 0);
+        for (size_t i = 0; i < live.size(); i++)
+        {
+            last_access[live[i].second] = i + 1;
+            tree[i + 1] = 1;
+        }
+        // Linear time Fenwick construction
+        for (size_t i = 1; i <= capacity; i++)
+        {
+            size_t parent = i + (i & (~i + 1));
+            if (parent <= capacity)
+            {
+                tree[parent] += tree[i];
+            }
+        }
+        now = live.size();
+    }
+
+    inline void update(size_t index, int delta)
+    {
+        for (; index <= capacity; index += index & (~index + 1))
+        {
+            tree[index] += delta;
+        }
+    }
+
+    inline long prefix_sum(size_t index) const
+    {
+        long sum = 0;
+        for (; index > 0; index -= index & (~index + 1))
+        {
+            sum += tree[index];
+        }
+        return sum;
+    }
+};
+
+#endif
@@ -0,0 +1,354 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef STRUCTURED_OUTPUT
+#define STRUCTURED_OUTPUT
+
+enum OUTPUT_FORMATS
+{
+    JSONL_OUTPUT,
+    CSV_OUTPUT
+};
+
+// Machine readable statistics, written next to (not instead of) the -o output
+typedef struct structured_config
+{
+    OUTPUT_FORMATS format;
+    // Time series sample every interval instructions, 0 = final records only
+    unsigned long interval;
+    // "-" = stdout
+    std::string file_name;
+} structured_config;
+
+// Parses "jsonl|csv[:interval[:file]]"
+structured_config parse_structured_config(const std::string &spec)
+{
+    structured_config config = {JSONL_OUTPUT, 0, "-"};
+    size_t colon = spec.find(':');
+    std::string format = spec.substr(0, colon);
+    if (format == "jsonl")
+    {
+        config.format = JSONL_OUTPUT;
+    }
+    else if (format == "csv")
+    {
+        config.format = CSV_OUTPUT;
+    }
+    else
+    {
+        throw std::invalid_argument("Invalid structured output format (jsonl / csv): " + spec);
+    }
+    if (colon != std::string::npos)
+    {
+        size_t file_colon = spec.find(':', colon + 1);
+        std::string interval = spec.substr(colon + 1, file_colon == std::string::npos ? std::string::npos : file_colon - colon - 1);
+        char *end;
+        config.interval = strtoul(interval.c_str(), &end, 10);
+        if (interval.empty() || *end != '\0')
+        {
+            throw std::invalid_argument("Invalid structured output interval: " + spec);
+        }
+        if (file_colon != std::string::npos && file_colon + 1 < spec.size())
+        {
+            config.file_name = spec.substr(file_colon + 1);
+        }
+    }
+    return config;
+}
+
+/* Record oriented writer for JSON Lines or CSV. A record is a type name, the
+   instruction count and pid it belongs to (-1 = none) and named values:
+   - JSON Lines: one object per record, {"record":"process","pid":0,"maps":12,...}
+   - CSV: one row per value in a fixed long format, record,inst,pid,metric,value
+   Lists become a JSON array, in CSV one row per element with the index as pid.
+   Everything goes through one large buffer written with write(). */
+class StructuredWriter
+{
+public:
+    StructuredWriter(const structured_config &config)
+    {
+        format = config.format;
+        interval = config.interval;
+        if (config.file_name == "-")
+        {
+            fd = STDOUT_FILENO;
+        }
+        else
+        {
+            fd = open(config.file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+            {
+                throw std::runtime_error("Could not open structured output file: " + config.file_name);
+            }
+            owns_fd = true;
+        }
+        buffer = new char[BUFFER_SIZE];
+        if (format == CSV_OUTPUT)
+        {
+            put_string("record,inst,pid,metric,value\n");
+        }
+    }
+
+    ~StructuredWriter()
+    {
+        flush();
+        if (owns_fd)
+        {
+            close(fd);
+        }
+        delete[] buffer;
+    }
+
+    // A time series sample is due after instruction inst (once per count)
+    inline bool sample_due(unsigned long inst)
+    {
+        if (!interval || inst % interval || inst == last_sample)
+        {
+            return false;
+        }
+        last_sample = inst;
+        return true;
+    }
+
+    unsigned long get_interval() const
+    {
+        return interval;
+    }
+
+    unsigned long get_last_sample() const
+    {
+        return last_sample;
+    }
+
+    void begin(const char *record, long inst = -1, long pid = -1)
+    {
+        // Values of a record are at most a few hundred bytes, flush between records only
+        if (len + RECORD_RESERVE > BUFFER_SIZE)
+        {
+            flush();
+        }
+        record_name = record;
+        record_inst = inst;
+        record_pid = pid;
+        if (format == JSONL_OUTPUT)
+        {
+            put_string("{\"record\":\"");
+            put_string(record);
+            put_char('"');
+            if (inst >= 0)
+            {
+                put_string(",\"inst\":");
+                put_number(inst);
+            }
+            if (pid >= 0)
+            {
+                put_string(",\"pid\":");
+                put_number(pid);
+            }
+        }
+    }
+
+    void field(const char *name, unsigned long long value)
+    {
+        begin_value(name, record_pid);
+        put_number(value);
+        end_value();
+    }
+
+    void field_real(const char *name, double value)
+    {
+        begin_value(name, record_pid);
+        if (value >= 0 && value < 1e15)
+        {
+            // Fixed point with up to 6 decimals, much cheaper than snprintf per sample
+            unsigned long long whole = (unsigned long long)value;
+            unsigned long long fraction = (unsigned long long)((value - whole) * 1e6 + 0.5);
+            if (fraction >= 1000000)
+            {
+                whole++;
+                fraction -= 1000000;
+            }
+            put_number(whole);
+            if (fraction)
+            {
+                char digits[7] = "000000";
+                for (int i = 5; i >= 0; i--, fraction /= 10)
+                {
+                    digits[i] = '0' + fraction % 10;
+                }
+                int n = 6;
+                while (digits[n - 1] == '0')
+                {
+                    n--;
+                }
+                digits[n] = '\0';
+                put_char('.');
+                put_string(digits);
+            }
+        }
+        else
+        {
+            char text[32];
+            int n = snprintf(text, sizeof(text), "%.6g", value);
+            ensure(n);
+            memcpy(buffer + len, text, n);
+            len += n;
+        }
+        end_value();
+    }
+
+    void field_list(const char *name, const std::vector<unsigned int> &values)
+    {
+        if (format == JSONL_OUTPUT)
+        {
+            put_string(",\"");
+            put_string(name);
+            put_string("\":[");
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                if (i)
+                {
+                    put_char(',');
+                }
+                put_number(values[i]);
+            }
+            put_char(']');
+            return;
+        }
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            begin_value(name, i);
+            put_number(values[i]);
+            end_value();
+        }
+    }
+
+    void end()
+    {
+        if (format == JSONL_OUTPUT)
+        {
+            put_string("}\n");
+        }
+    }
+
+    void flush()
+    {
+        // Sharing stdout with the printf output: keep the two in order
+        if (fd == STDOUT_FILENO)
+        {
+            fflush(stdout);
+        }
+        size_t written = 0;
+        while (written < len)
+        {
+            ssize_t n = write(fd, buffer + written, len - written);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                throw std::runtime_error("Could not write structured output");
+            }
+            written += n;
+        }
+        len = 0;
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+    static const size_t RECORD_RESERVE = 4096;
+    OUTPUT_FORMATS format;
+    unsigned long interval;
+    unsigned long last_sample = 0;
+    int fd = -1;
+    bool owns_fd = false;
+    char *buffer = nullptr;
+    size_t len = 0;
+    const char *record_name = "";
+    long record_inst = -1;
+    long record_pid = -1;
+
+    // JSON: ,"name": / CSV: record,inst,pid,name,
+    void begin_value(const char *name, long pid)
+    {
+        if (format == JSONL_OUTPUT)
+        {
+            put_string(",\"");
+            put_string(name);
+            put_string("\":");
+            return;
+        }
+        put_string(record_name);
+        put_char(',');
+        if (record_inst >= 0)
+        {
+            put_number(record_inst);
+        }
+        put_char(',');
+        if (pid >= 0)
+        {
+            put_number(pid);
+        }
+        put_char(',');
+        put_string(name);
+        put_char(',');
+    }
+
+    void end_value()
+    {
+        if (format == CSV_OUTPUT)
+        {
+            put_char('\n');
+        }
+    }
+
+    inline void ensure(size_t n)
+    {
+        if (len + n > BUFFER_SIZE)
+        {
+            flush();
+        }
+    }
+
+    inline void put_char(char c)
+    {
+        ensure(1);
+        buffer[len++] = c;
+    }
+
+    void put_string(const char *text)
+    {
+        size_t n = strlen(text);
+        ensure(n);
+        memcpy(buffer + len, text, n);
+        len += n;
+    }
+
+    // Digits are produced back to front, then copied in order
+    inline void put_number(unsigned long long value)
+    {
+        char digits[20];
+        int n = 0;
+        do
+        {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value);
+        ensure(n);
+        while (n)
+        {
+            buffer[len++] = digits[--n];
+        }
+    }
+};
+
+#endif
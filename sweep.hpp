@@ -0,0 +1,207 @@
+#include "data_structures.hpp"
+#include "mmu_pagers.hpp"
+#include "simulation.hpp"
+#include "trace_format.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef SWEEP
+#define SWEEP
+
+/* Multi configuration sweep: the trace is loaded once and every
+   (pager, frame count) pair is simulated by an independent Pager with its
+   own copy of the Process page tables. Configurations are handed out to a
+   pool of worker threads, results are printed in configuration order. */
+
+typedef struct sweep_config
+{
+    PAGER_TYPES pager_type;
+    unsigned int num_frames;
+} sweep_config;
+
+// Parses a comma separated list of pager letters, i.e. "f,c,a"
+std::vector<PAGER_TYPES> parse_pager_list(const std::string &list)
+{
+    std::vector<PAGER_TYPES> pagers;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = list.size();
+        }
+        std::string token = list.substr(start, end - start);
+        if (!token.empty())
+        {
+            pagers.push_back(parse_pager_type_from_input((char *)token.c_str()));
+        }
+        start = end + 1;
+    }
+    return pagers;
+}
+
+// Parses a comma separated list of frame counts and ranges, i.e. "1-8,16,32"
+std::vector<unsigned int> parse_frame_list(const std::string &list)
+{
+    std::vector<unsigned int> frames;
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = list.size();
+        }
+        std::string token = list.substr(start, end - start);
+        if (!token.empty())
+        {
+            unsigned int lo = 0, hi = 0;
+            int n = sscanf(token.c_str(), "%u-%u", &lo, &hi);
+            if (n < 1 || lo == 0 || (n == 2 && hi < lo))
+            {
+                throw std::invalid_argument("Invalid frame count list: " + list);
+            }
+            if (n == 1)
+            {
+                hi = lo;
+            }
+            // Every count of the range must fit the frame table
+            check_frame_count(hi);
+            for (unsigned int f = lo; f <= hi; f++)
+            {
+                frames.push_back(f);
+            }
+        }
+        start = end + 1;
+    }
+    return frames;
+}
+
+// Copies a Process array so each configuration owns its page tables
+// (the copy includes the VMA index)
+Process *clone_process_arr(const Process *process_arr, unsigned int num_processes)
+{
+    Process *copy = new Process[num_processes];
+    for (unsigned int i = 0; i < num_processes; i++)
+    {
+        copy[i] = process_arr[i];
+    }
+    return copy;
+}
+
+class SweepEngine
+{
+public:
+    SweepEngine(const std::vector<sweep_config> &configs_, const trace_record *records_begin_, const trace_record *records_end_,
+                const Process *process_arr_, unsigned int num_processes_, int r_array_size_, int *randvals_,
+                const pager_options &options_)
+    {
+        configs = configs_;
+        records_begin = records_begin_;
+        records_end = records_end_;
+        process_arr = process_arr_;
+        num_processes = num_processes_;
+        r_array_size = r_array_size_;
+        randvals = randvals_;
+        options = options_;
+    }
+
+    // Simulates every configuration on num_threads workers and prints the results
+    void run(unsigned int num_threads, FILE *out = stdout)
+    {
+        results.assign(configs.size(), std::string());
+
+        // Clone page tables up front, Process construction is not thread safe
+        std::vector<Process *> clones;
+        for (size_t i = 0; i < configs.size(); i++)
+        {
+            clones.push_back(clone_process_arr(process_arr, num_processes));
+        }
+
+        if (num_threads == 0)
+        {
+            num_threads = 1;
+        }
+        if (num_threads > configs.size())
+        {
+            num_threads = configs.size();
+        }
+
+        // Workers pull the next configuration index until all are done
+        std::atomic<size_t> next_config(0);
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < num_threads; t++)
+        {
+            workers.push_back(std::thread([this, &next_config, &clones]()
+                                          {
+                size_t i;
+                while ((i = next_config++) < configs.size())
+                {
+                    results[i] = simulate(configs[i], clones[i]);
+                    delete[] clones[i];
+                } }));
+        }
+        for (size_t t = 0; t < workers.size(); t++)
+        {
+            workers[t].join();
+        }
+
+        // Output table, one block per configuration
+        for (size_t i = 0; i < configs.size(); i++)
+        {
+            fprintf(out, "SWEEP %s %u\n", GET_PAGER_NAME_FROM_ENUM(configs[i].pager_type), configs[i].num_frames);
+            fputs(results[i].c_str(), out);
+        }
+    }
+
+private:
+    std::vector<sweep_config> configs;
+    std::vector<std::string> results;
+    const trace_record *records_begin;
+    const trace_record *records_end;
+    const Process *process_arr;
+    unsigned int num_processes;
+    int r_array_size;
+    int *randvals;
+    pager_options options;
+
+    // Runs a single configuration, returns its PROC[] + TOTALCOST lines
+    std::string simulate(const sweep_config &config, Process *process_copy)
+    {
+        Pager *pager = build_configured_pager(config.pager_type, config.num_frames, r_array_size, randvals, false, false, options);
+        pager->init_process_metadata(num_processes, process_copy);
+
+        sim_state state;
+        state.THE_PAGER = pager;
+        state.process_arr = process_copy;
+        state.CURRENT_PROCESS = nullptr;
+        state.current_process_num = 0;
+        state.inst_count = 0;
+        state.output = nullptr;
+        for (const trace_record *record = records_begin; record != records_end; record++)
+        {
+            execute_instruction(&state, (char)record->op, (int)record->arg);
+        }
+
+        // Capture the regular stats output in memory
+        char *buf = nullptr;
+        size_t len = 0;
+        FILE *mem = open_memstream(&buf, &len);
+        pager->print_per_process_stats(mem);
+        pager->print_total_cost(mem);
+        fclose(mem);
+        std::string result(buf, len);
+        free(buf);
+
+        delete pager;
+        return result;
+    }
+};
+
+#endif
@@ -0,0 +1,171 @@
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef TLB
+#define TLB
+
+// TLB geometry, entries == 0 means no TLB
+typedef struct tlb_config
+{
+    unsigned int entries;
+    unsigned int ways;
+    // Entries tagged with the pid (ASID) survive context switches, otherwise 'c' flushes the TLB
+    bool asids;
+} tlb_config;
+
+// Parses "entries[:ways[:flush]]", i.e. "64:4" or "64:4:flush"
+tlb_config parse_tlb_config(const std::string &spec)
+{
+    tlb_config config = {0, 0, true};
+    char mode[16] = {0};
+    int n = sscanf(spec.c_str(), "%u:%u:%15s", &config.entries, &config.ways, mode);
+    if (n < 2)
+    {
+        // Default to 4 way, fully associative if smaller
+        config.ways = config.entries < 4 ? config.entries : 4;
+    }
+    if (n == 3)
+    {
+        std::string flush_mode(mode);
+        if (flush_mode != "flush" && flush_mode != "asid")
+        {
+            throw std::invalid_argument("Invalid TLB mode (asid / flush): " + spec);
+        }
+        config.asids = flush_mode == "asid";
+    }
+    if (n < 1 || config.entries == 0 || config.ways == 0 || config.entries % config.ways != 0)
+    {
+        throw std::invalid_argument("Invalid TLB geometry, entries must be a multiple of ways: " + spec);
+    }
+    return config;
+}
+
+/* Set associative TLB caching (pid, vpage) translations, LRU within a set.
+   It only models hits and misses: the page table stays the source of truth
+   for the translation and its bits, so entries must be invalidated whenever
+   a mapping goes away (shootdown on unmap, flush on exit / context switch). */
+class Tlb
+{
+public:
+    Tlb(const tlb_config &config_)
+    {
+        config = config_;
+        num_sets = config.entries / config.ways;
+        entries.assign(config.entries, tlb_entry());
+    }
+
+    const tlb_config &get_config() const
+    {
+        return config;
+    }
+
+    // Returns true on a hit and refreshes the entry's LRU position
+    bool lookup(unsigned int asid, unsigned int vpage)
+    {
+        tlb_entry *set = set_of(vpage);
+        for (unsigned int way = 0; way < config.ways; way++)
+        {
+            if (set[way].valid && set[way].vpage == vpage && set[way].asid == asid)
+            {
+                set[way].last_use = ++clock;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Installs a translation, evicting an invalid or the least recently used way
+    void insert(unsigned int asid, unsigned int vpage)
+    {
+        tlb_entry *set = set_of(vpage);
+        tlb_entry *victim = &set[0];
+        for (unsigned int way = 0; way < config.ways; way++)
+        {
+            if (!set[way].valid)
+            {
+                victim = &set[way];
+                break;
+            }
+            if (set[way].last_use < victim->last_use)
+            {
+                victim = &set[way];
+            }
+        }
+        victim->valid = true;
+        victim->asid = asid;
+        victim->vpage = vpage;
+        victim->last_use = ++clock;
+    }
+
+    // Full flush, i.e. on a context switch without ASIDs
+    void flush()
+    {
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            entries[i].valid = false;
+        }
+        flushes++;
+    }
+
+    // Drops every translation of one address space (process exit)
+    void flush_asid(unsigned int asid)
+    {
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            if (entries[i].asid == asid)
+            {
+                entries[i].valid = false;
+            }
+        }
+    }
+
+    // Invalidates a single translation after its page was unmapped
+    void shootdown(unsigned int asid, unsigned int vpage)
+    {
+        tlb_entry *set = set_of(vpage);
+        for (unsigned int way = 0; way < config.ways; way++)
+        {
+            if (set[way].vpage == vpage && set[way].asid == asid)
+            {
+                set[way].valid = false;
+            }
+        }
+        shootdowns++;
+    }
+
+    unsigned long get_flushes() const
+    {
+        return flushes;
+    }
+
+    unsigned long get_shootdowns() const
+    {
+        return shootdowns;
+    }
+
+private:
+    typedef struct tlb_entry
+    {
+        bool valid = false;
+        unsigned int asid = 0;
+        unsigned int vpage = 0;
+        uint64_t last_use = 0;
+    } tlb_entry;
+
+    tlb_config config;
+    unsigned int num_sets;
+    std::vector<tlb_entry> entries;
+    uint64_t clock = 0;
+    unsigned long flushes = 0;
+    unsigned long shootdowns = 0;
+
+    inline tlb_entry *set_of(unsigned int vpage)
+    {
+        return &entries[(size_t)(vpage % num_sets) * config.ways];
+    }
+};
+
+#endif
@@ -0,0 +1,45 @@
+#include <iostream>
+#include <string>
+#include "trace_format.hpp"
+#include "trace_stream.hpp"
+
+// Converts a des_mmu text input file into the binary trace format
+// usage: trace_convert <text_input_file | -> <binary_output_file>
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s <text_input_file | -> <binary_output_file>\n", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        // Read in Num Process -> VMA specs, same layout des_mmu expects
+        TraceTokenizer input(argv[1]);
+        std::vector<uint32_t> vma_counts;
+        std::vector<trace_vma_spec> vmas;
+        input.read_header(vma_counts, vmas);
+
+        // Stream the instructions straight into the binary writer
+        TraceWriter writer(argv[2], vma_counts, vmas);
+        char operation;
+        int arg = 0;
+        while (input.next_instruction(operation, arg))
+        {
+            if (operation == 'c' || operation == 'r' || operation == 'w' || operation == 'e' || operation == 'f' ||
+                operation == 'z')
+            {
+                writer.add_record(operation, arg);
+            }
+        }
+        writer.finish();
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,281 @@
+#include "data_structures.hpp"
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef TRACE_FORMAT
+#define TRACE_FORMAT
+
+/* Binary trace layout (all fields native endian, 8 byte aligned sections):
+   [trace_file_header]
+   [uint32_t vma_count per process] x num_processes
+   [trace_vma_spec] x num_vmas
+   (zero padding up to the next 8 byte boundary)
+   [trace_record] x num_records
+   The header holds the same process / VMA specs Process::add_vma receives,
+   the records hold the instruction stream in input order. */
+
+const char TRACE_MAGIC[4] = {'D', 'M', 'T', 'R'};
+const uint32_t TRACE_VERSION = 1;
+
+typedef struct trace_file_header
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t num_processes;
+    uint32_t reserved;
+    uint64_t num_vmas;
+    uint64_t num_records;
+} trace_file_header;
+
+// VMA spec exactly as read from a text input VMA line
+typedef struct trace_vma_spec
+{
+    uint32_t start_vpage;
+    uint32_t end_vpage;
+    uint32_t write_protected;
+    uint32_t file_mapped;
+} trace_vma_spec;
+
+// Packed instruction: operation character ('c', 'r', 'w', 'e', 'f' or the 'z' annotation) + argument
+typedef struct trace_record
+{
+    uint64_t op : 8;
+    uint64_t arg : 56;
+} trace_record;
+
+// Offset of the first record, given the header counts
+inline size_t trace_records_offset(uint32_t num_processes, uint64_t num_vmas)
+{
+    size_t offset = sizeof(trace_file_header);
+    offset += num_processes * sizeof(uint32_t);
+    offset += num_vmas * sizeof(trace_vma_spec);
+    // Align records to 8 bytes
+    return (offset + 7) & ~((size_t)7);
+}
+
+// Helper function to sniff if a file on disk is a binary trace
+bool is_binary_trace(const std::string &file_name)
+{
+    char magic[4] = {0, 0, 0, 0};
+    FILE *fp = fopen(file_name.c_str(), "rb");
+    if (!fp)
+    {
+        return false;
+    }
+    size_t n = fread(magic, 1, sizeof(magic), fp);
+    fclose(fp);
+    return n == sizeof(magic) && memcmp(magic, TRACE_MAGIC, sizeof(magic)) == 0;
+}
+
+// Builds a Process array from per process VMA counts + the flat list of VMA specs
+Process *build_process_arr(unsigned int num_processes, const uint32_t *vma_counts, const trace_vma_spec *vmas)
+{
+    Process *process_arr = new Process[num_processes];
+    const trace_vma_spec *vma = vmas;
+    for (unsigned int i = 0; i < num_processes; i++)
+    {
+        process_arr[i].init_vma(vma_counts[i]);
+        for (unsigned int vma_num = 0; vma_num < vma_counts[i]; vma_num++, vma++)
+        {
+            process_arr[i].add_vma(vma_num, vma->start_vpage, vma->end_vpage, vma->write_protected, vma->file_mapped);
+        }
+    }
+    return process_arr;
+}
+
+// Writes a binary trace. Records are streamed, counts get patched in on finish()
+class TraceWriter
+{
+public:
+    TraceWriter(const std::string &file_name, const std::vector<uint32_t> &vma_counts_, const std::vector<trace_vma_spec> &vmas_)
+    {
+        fp = fopen(file_name.c_str(), "wb");
+        if (!fp)
+        {
+            throw std::runtime_error("Could not open trace output file: " + file_name);
+        }
+
+        memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+        header.version = TRACE_VERSION;
+        header.num_processes = vma_counts_.size();
+        header.reserved = 0;
+        header.num_vmas = vmas_.size();
+        header.num_records = 0;
+
+        // Write header (record count patched later), specs and alignment padding
+        fwrite(&header, sizeof(header), 1, fp);
+        if (!vma_counts_.empty())
+        {
+            fwrite(vma_counts_.data(), sizeof(uint32_t), vma_counts_.size(), fp);
+        }
+        if (!vmas_.empty())
+        {
+            fwrite(vmas_.data(), sizeof(trace_vma_spec), vmas_.size(), fp);
+        }
+        size_t written = sizeof(header) + vma_counts_.size() * sizeof(uint32_t) + vmas_.size() * sizeof(trace_vma_spec);
+        size_t padding = trace_records_offset(header.num_processes, header.num_vmas) - written;
+        const char zeros[8] = {0};
+        fwrite(zeros, 1, padding, fp);
+    }
+
+    ~TraceWriter()
+    {
+        finish();
+    }
+
+    void add_record(char operation, uint64_t arg)
+    {
+        trace_record record;
+        record.op = (unsigned char)operation;
+        record.arg = arg;
+        buffer[buffered++] = record;
+        if (buffered == BUFFER_RECORDS)
+        {
+            flush();
+        }
+        header.num_records++;
+    }
+
+    // Flushes remaining records and rewrites the header with the final count
+    void finish()
+    {
+        if (!fp)
+        {
+            return;
+        }
+        flush();
+        fseek(fp, 0, SEEK_SET);
+        fwrite(&header, sizeof(header), 1, fp);
+        fclose(fp);
+        fp = nullptr;
+    }
+
+private:
+    static const size_t BUFFER_RECORDS = 4096;
+    FILE *fp = nullptr;
+    trace_file_header header;
+    trace_record buffer[BUFFER_RECORDS];
+    size_t buffered = 0;
+
+    void flush()
+    {
+        if (buffered)
+        {
+            fwrite(buffer, sizeof(trace_record), buffered, fp);
+            buffered = 0;
+        }
+    }
+};
+
+// Read only, memory mapped view of a binary trace
+class MappedTrace
+{
+public:
+    MappedTrace(const std::string &file_name)
+    {
+        int fd = open(file_name.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Could not open trace file: " + file_name);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(trace_file_header))
+        {
+            close(fd);
+            throw std::runtime_error("Trace file too small: " + file_name);
+        }
+        map_len = st.st_size;
+        void *addr = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED)
+        {
+            throw std::runtime_error("Could not mmap trace file: " + file_name);
+        }
+        base = (const char *)addr;
+
+        // Validate header before trusting any of the counts
+        header = (const trace_file_header *)base;
+        if (memcmp(header->magic, TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0 || header->version != TRACE_VERSION)
+        {
+            munmap((void *)base, map_len);
+            throw std::runtime_error("Not a des_mmu binary trace: " + file_name);
+        }
+        // Counts are bounded by the file size before any multiplication, so none can overflow
+        bool valid = header->num_vmas <= map_len / sizeof(trace_vma_spec);
+        size_t records_offset = valid ? trace_records_offset(header->num_processes, header->num_vmas) : 0;
+        valid = valid && records_offset <= map_len &&
+                header->num_records <= (map_len - records_offset) / sizeof(trace_record);
+
+        vma_counts = (const uint32_t *)(base + sizeof(trace_file_header));
+        vmas = (const trace_vma_spec *)(vma_counts + header->num_processes);
+        // Processes can't claim more VMA specs than the header holds
+        uint64_t total_vmas = 0;
+        for (uint32_t i = 0; valid && i < header->num_processes; i++)
+        {
+            total_vmas += vma_counts[i];
+            valid = total_vmas <= header->num_vmas;
+        }
+        if (!valid)
+        {
+            munmap((void *)base, map_len);
+            throw std::runtime_error("Truncated binary trace: " + file_name);
+        }
+        records = (const trace_record *)(base + records_offset);
+
+        // Records are consumed front to back exactly once
+        madvise((void *)base, map_len, MADV_SEQUENTIAL);
+    }
+
+    ~MappedTrace()
+    {
+        munmap((void *)base, map_len);
+    }
+
+    unsigned int get_num_processes() const
+    {
+        return header->num_processes;
+    }
+
+    uint64_t get_num_records() const
+    {
+        return header->num_records;
+    }
+
+    const trace_record *begin() const
+    {
+        return records;
+    }
+
+    const trace_record *end() const
+    {
+        return records + header->num_records;
+    }
+
+    // Builds the Process array from the VMA specs stored in the header
+    Process *build_processes() const
+    {
+        return build_process_arr(header->num_processes, vma_counts, vmas);
+    }
+
+private:
+    const char *base = nullptr;
+    size_t map_len = 0;
+    const trace_file_header *header;
+    const uint32_t *vma_counts;
+    const trace_vma_spec *vmas;
+    const trace_record *records;
+
+    // Non copyable, owns the mapping
+    MappedTrace(const MappedTrace &);
+    MappedTrace &operator=(const MappedTrace &);
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include <cstdlib>
+#include <string>
+#include <getopt.h>
+#include "trace_format.hpp"
+#include "trace_stream.hpp"
+#include "workload.hpp"
+
+const char *USAGE =
+    "usage: %s [-p processes] [-n instructions] [-P pages] [-V vmas] [-F file%%] [-X write protected%%]\n"
+    "          [-w write%%] [-m model[:param],...] [-l phase_length] [-q min[:max]] [-r] [-k fork_after]\n"
+    "          [-s seed] [-b] <output_file | ->\n";
+
+// Counts with an optional k / M / G suffix, i.e. 2G
+uint64_t parse_count(const char *text)
+{
+    char *end;
+    uint64_t count = strtoull(text, &end, 10);
+    switch (*end)
+    {
+    case 'k':
+    case 'K':
+        count *= 1000ULL;
+        end++;
+        break;
+    case 'm':
+    case 'M':
+        count *= 1000000ULL;
+        end++;
+        break;
+    case 'g':
+    case 'G':
+        count *= 1000000000ULL;
+        end++;
+        break;
+    }
+    if (end == text || *end != '\0')
+    {
+        throw std::invalid_argument(std::string("Invalid count: ") + text);
+    }
+    return count;
+}
+
+// Generates a synthetic des_mmu input, text or binary trace format
+int main(int argc, char **argv)
+{
+    workload_config config = default_workload_config();
+    bool binary = false;
+    int c;
+
+    try
+    {
+        while ((c = getopt(argc, argv, "p:n:P:V:F:X:w:m:l:q:rk:s:b")) != -1)
+        {
+            switch (c)
+            {
+            case 'p':
+                config.num_processes = parse_count(optarg);
+                break;
+            case 'n':
+                config.num_instructions = parse_count(optarg);
+                break;
+            case 'P':
+                config.pages = parse_count(optarg);
+                break;
+
+            // Address space layout: VMA count, odds of file mapped / write protected VMAs
+            case 'V':
+                config.num_vmas = parse_count(optarg);
+                break;
+            case 'F':
+                config.file_percent = atoi(optarg);
+                break;
+            case 'X':
+                config.write_protect_percent = atoi(optarg);
+                break;
+
+            case 'w':
+                config.write_percent = atoi(optarg);
+                break;
+
+            // Access models: phases taking turns every -l instructions
+            case 'm':
+                config.phases = parse_workload_phases(optarg);
+                break;
+            case 'l':
+                config.phase_length = parse_count(optarg);
+                break;
+
+            // Scheduling: slice length min[:max], random process order
+            case 'q':
+                if (sscanf(optarg, "%u:%u", &config.quantum_min, &config.quantum_max) < 2)
+                {
+                    config.quantum_max = config.quantum_min;
+                }
+                break;
+            case 'r':
+                config.random_order = true;
+                break;
+
+            // Process 0 forks every other process after this many instructions
+            case 'k':
+                config.fork_after = parse_count(optarg);
+                break;
+
+            case 's':
+                config.seed = parse_count(optarg);
+                break;
+            case 'b':
+                binary = true;
+                break;
+
+            case '?':
+                fprintf(stderr, USAGE, argv[0]);
+                return 1;
+            }
+        }
+        if (optind != argc - 1)
+        {
+            fprintf(stderr, USAGE, argv[0]);
+            return 1;
+        }
+        std::string output_name = argv[optind];
+
+        WorkloadGenerator generator(config);
+        std::vector<uint32_t> vma_counts;
+        std::vector<trace_vma_spec> vmas;
+        generator.header(vma_counts, vmas);
+        char operation;
+        int arg;
+        if (binary)
+        {
+            // The record count is patched into the header at the end, needs a seekable file
+            if (output_name == "-")
+            {
+                throw std::invalid_argument("Binary traces need an output file, not stdout");
+            }
+            TraceWriter writer(output_name, vma_counts, vmas);
+            while (generator.next(operation, arg))
+            {
+                writer.add_record(operation, arg);
+            }
+            writer.finish();
+        }
+        else
+        {
+            TextTraceWriter writer(output_name, vma_counts, vmas);
+            while (generator.next(operation, arg))
+            {
+                writer.add_record(operation, arg);
+            }
+            writer.finish();
+        }
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
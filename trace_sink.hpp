@@ -0,0 +1,300 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#ifndef TRACE_SINK
+#define TRACE_SINK
+
+/* The O option output as binary events. Instead of formatting every line with
+   printf on the simulation path, the simulation emits small fixed size events
+   into a trace sink; the text is produced from them by format_trace_event. */
+enum TRACE_EVENT_TYPES
+{
+    // "<inst>: ==> <op> <arg>", a = instruction count, b = operation, c = argument
+    TRACE_INSTRUCTION,
+    // "EXIT current process <a>"
+    TRACE_EXIT,
+    // " <name>"
+    TRACE_IN,
+    TRACE_OUT,
+    TRACE_FIN,
+    TRACE_FOUT,
+    TRACE_ZERO,
+    TRACE_SEGV,
+    TRACE_SEGPROT,
+    TRACE_COPY,
+    TRACE_RAIN,
+    TRACE_RAFIN,
+    TRACE_ZLOAD,
+    TRACE_ZSTORE,
+    // " <name> <a>"
+    TRACE_MAP,
+    TRACE_FORK,
+    TRACE_PROMOTE,
+    TRACE_DEMOTE,
+    // " <name> <a>:<b>"
+    TRACE_UNMAP,
+    TRACE_ZWB,
+    TRACE_READAHEAD,
+    TRACE_BGOUT,
+    TRACE_BGFOUT
+};
+
+const char *TRACE_EVENT_NAMES[] = {"", "EXIT current process", " IN", " OUT", " FIN", " FOUT", " ZERO", " SEGV", " SEGPROT",
+                                   " COPY", " RAIN", " RAFIN", " ZLOAD", " ZSTORE", " MAP", " FORK", " PROMOTE", " DEMOTE",
+                                   " UNMAP", " ZWB", " READAHEAD", " BGOUT", " BGFOUT"};
+
+typedef struct trace_event
+{
+    // 64 bit so instruction counts past 2^31 print correctly
+    int64_t a;
+    int32_t type;
+    int32_t b;
+    int32_t c;
+} trace_event;
+
+// Longest formatted event: a number of up to 20 characters, 2 of up to 11 plus the text
+const size_t MAX_TRACE_EVENT_TEXT = 64;
+
+inline char *format_trace_int(char *out, int64_t value)
+{
+    uint64_t magnitude = value < 0 ? 0u - (uint64_t)value : (uint64_t)value;
+    if (value < 0)
+    {
+        *out++ = '-';
+    }
+    char digits[20];
+    int n = 0;
+    do
+    {
+        digits[n++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    while (n)
+    {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+// Writes the text line of an event (same as the printf it replaces), returns its length
+inline size_t format_trace_event(const trace_event &event, char *text)
+{
+    char *out = text;
+    if (event.type == TRACE_INSTRUCTION)
+    {
+        out = format_trace_int(out, event.a);
+        *out++ = ':';
+        *out++ = ' ';
+        *out++ = '=';
+        *out++ = '=';
+        *out++ = '>';
+        *out++ = ' ';
+        *out++ = (char)event.b;
+        *out++ = ' ';
+        out = format_trace_int(out, event.c);
+    }
+    else
+    {
+        for (const char *name = TRACE_EVENT_NAMES[event.type]; *name; name++)
+        {
+            *out++ = *name;
+        }
+        if (event.type == TRACE_EXIT || (event.type >= TRACE_MAP && event.type <= TRACE_DEMOTE))
+        {
+            *out++ = ' ';
+            out = format_trace_int(out, event.a);
+        }
+        else if (event.type >= TRACE_UNMAP)
+        {
+            *out++ = ' ';
+            out = format_trace_int(out, event.a);
+            *out++ = ':';
+            out = format_trace_int(out, event.b);
+        }
+    }
+    *out++ = '\n';
+    return out - text;
+}
+
+/* Lock-free single producer / single consumer ring of events. Each index is
+   only written by one side, the other side reads it with acquire ordering;
+   the two indexes sit on separate cache lines. */
+class TraceRing
+{
+public:
+    TraceRing(size_t capacity_)
+    {
+        // Power of two, so positions wrap with a mask
+        capacity = 1;
+        while (capacity < capacity_)
+        {
+            capacity <<= 1;
+        }
+        mask = capacity - 1;
+        slots.resize(capacity);
+    }
+
+    // Producer side, false if the ring is full
+    inline bool push(const trace_event &event)
+    {
+        size_t position = head.load(std::memory_order_relaxed);
+        if (position - cached_tail == capacity)
+        {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (position - cached_tail == capacity)
+            {
+                return false;
+            }
+        }
+        slots[position & mask] = event;
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, takes up to max events in order
+    size_t pop(trace_event *events, size_t max)
+    {
+        size_t position = tail.load(std::memory_order_relaxed);
+        size_t available = head.load(std::memory_order_acquire) - position;
+        size_t n = available < max ? available : max;
+        for (size_t i = 0; i < n; i++)
+        {
+            events[i] = slots[(position + i) & mask];
+        }
+        tail.store(position + n, std::memory_order_release);
+        return n;
+    }
+
+private:
+    std::vector<trace_event> slots;
+    size_t capacity;
+    size_t mask;
+    char head_line[64];
+    std::atomic<size_t> head{0};
+    // Producer's last view of tail, saves an acquire load per push
+    size_t cached_tail = 0;
+    char tail_line[64];
+    std::atomic<size_t> tail{0};
+};
+
+/* Trace sink of the O output. It starts out formatting every event in place.
+   After start_async, events go into a TraceRing and a background thread
+   formats and writes them, so the simulation only pays for the push. Nothing
+   else may write to the output until finish() has drained the ring. */
+class RingTraceSink
+{
+public:
+    static const bool enabled = true;
+
+    RingTraceSink(FILE *out_ = stdout) : ring(RING_CAPACITY)
+    {
+        out = out_;
+    }
+
+    ~RingTraceSink()
+    {
+        finish();
+    }
+
+    void start_async()
+    {
+        if (!async)
+        {
+            stopping.store(false, std::memory_order_relaxed);
+            fflush(out);
+            formatter = std::thread(&RingTraceSink::drain, this);
+            async = true;
+        }
+    }
+
+    inline void emit(TRACE_EVENT_TYPES type, int64_t a = 0, int b = 0, int c = 0)
+    {
+        trace_event event = {a, type, b, c};
+        if (!async)
+        {
+            char text[MAX_TRACE_EVENT_TEXT];
+            fwrite(text, 1, format_trace_event(event, text), out);
+            return;
+        }
+        while (!ring.push(event))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // Waits for the formatter to write out everything emitted so far and stops it
+    void finish()
+    {
+        if (!async)
+        {
+            return;
+        }
+        stopping.store(true, std::memory_order_release);
+        formatter.join();
+        async = false;
+        fflush(out);
+    }
+
+private:
+    static const size_t RING_CAPACITY = 1 << 16;
+    static const size_t BATCH = 1024;
+    TraceRing ring;
+    FILE *out;
+    bool async = false;
+    std::atomic<bool> stopping{false};
+    std::thread formatter;
+
+    void drain()
+    {
+        std::vector<trace_event> batch(BATCH);
+        std::vector<char> text(BATCH * MAX_TRACE_EVENT_TEXT);
+        while (true)
+        {
+            // Read before popping: once set, this pop sees every event emitted before finish()
+            bool last = stopping.load(std::memory_order_acquire);
+            size_t n = ring.pop(batch.data(), BATCH);
+            if (n)
+            {
+                size_t len = 0;
+                for (size_t i = 0; i < n; i++)
+                {
+                    len += format_trace_event(batch[i], text.data() + len);
+                }
+                fwrite(text.data(), 1, len, out);
+            }
+            else if (last)
+            {
+                return;
+            }
+            else
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+    }
+};
+
+// Trace sink of builds without tracing: every emit compiles to nothing
+class NullTraceSink
+{
+public:
+    static const bool enabled = false;
+
+    NullTraceSink(FILE *out_ = stdout) {}
+    void start_async() {}
+    inline void emit(TRACE_EVENT_TYPES type, int64_t a = 0, int b = 0, int c = 0) {}
+    void finish() {}
+};
+
+// Compile-time sink policy, built with -DNO_TRACE (make TRACE=-DNO_TRACE) the O output is gone entirely
+#ifdef NO_TRACE
+typedef NullTraceSink TraceSink;
+#else
+typedef RingTraceSink TraceSink;
+#endif
+
+#endif
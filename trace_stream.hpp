@@ -0,0 +1,367 @@
+#include "trace_format.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef TRACE_STREAM
+#define TRACE_STREAM
+
+/* Single pass tokenizer for the des_mmu text input format.
+   Reads the process / VMA header and then the instruction stream in one
+   forward pass over a large buffer refilled with read(), so it works the
+   same on regular files, pipes and stdin ("-"). */
+class TraceTokenizer
+{
+public:
+    TraceTokenizer(const std::string &file_name)
+    {
+        if (file_name == "-")
+        {
+            fd = STDIN_FILENO;
+        }
+        else
+        {
+            fd = open(file_name.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                throw std::runtime_error("Could not open input file: " + file_name);
+            }
+            owns_fd = true;
+        }
+        buffer = new char[BUFFER_SIZE];
+    }
+
+    ~TraceTokenizer()
+    {
+        if (owns_fd)
+        {
+            close(fd);
+        }
+        delete[] buffer;
+    }
+
+    // Reads num processes + every process's VMA specs
+    // Comment lines are skipped except inside a VMA block (same as the original parser)
+    unsigned int read_header(std::vector<uint32_t> &vma_counts, std::vector<trace_vma_spec> &vmas)
+    {
+        unsigned long num_processes = 0;
+        while (!num_processes)
+        {
+            if (!next_data_line())
+            {
+                throw std::runtime_error("Unexpected end of input while reading number of processes");
+            }
+            read_number(num_processes);
+            skip_line();
+        }
+
+        for (unsigned long process_num = 0; process_num < num_processes; process_num++)
+        {
+            unsigned long vma_lines_to_read = 0;
+            if (!next_data_line())
+            {
+                throw std::runtime_error("Unexpected end of input while reading VMA specs");
+            }
+            read_number(vma_lines_to_read);
+            skip_line();
+            vma_counts.push_back(vma_lines_to_read);
+
+            // Read in however many VMA lines there are
+            for (unsigned long vma_num = 0; vma_num < vma_lines_to_read; vma_num++)
+            {
+                unsigned long start_vpage = 0, end_vpage = 0, write_protected = 0, file_mapped = 0;
+                read_number(start_vpage);
+                read_number(end_vpage);
+                read_number(write_protected);
+                read_number(file_mapped);
+                skip_line();
+
+                trace_vma_spec vma = {(uint32_t)start_vpage, (uint32_t)end_vpage, (uint32_t)write_protected, (uint32_t)file_mapped};
+                vmas.push_back(vma);
+            }
+        }
+        return num_processes;
+    }
+
+    // Convenience wrapper that reads the header straight into a Process array
+    Process *read_processes(unsigned int &num_processes)
+    {
+        std::vector<uint32_t> vma_counts;
+        std::vector<trace_vma_spec> vmas;
+        num_processes = read_header(vma_counts, vmas);
+        return build_process_arr(num_processes, vma_counts.data(), vmas.data());
+    }
+
+    // Next instruction: operation char + argument (left untouched if the line has none)
+    // Returns false once the input is exhausted
+    bool next_instruction(char &operation, int &arg)
+    {
+        if (!next_data_line())
+        {
+            return false;
+        }
+        operation = (char)peek();
+        advance();
+        unsigned long value;
+        if (read_number(value))
+        {
+            arg = (int)value;
+        }
+        skip_line();
+        return true;
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+    int fd = -1;
+    bool owns_fd = false;
+    char *buffer = nullptr;
+    size_t pos = 0;
+    size_t len = 0;
+    bool eof = false;
+
+    // Refill buffer from the source, returns false at end of input
+    bool refill()
+    {
+        if (eof)
+        {
+            return false;
+        }
+        ssize_t n;
+        do
+        {
+            n = read(fd, buffer, BUFFER_SIZE);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0)
+        {
+            eof = true;
+            return false;
+        }
+        pos = 0;
+        len = n;
+        return true;
+    }
+
+    // Current character or -1 at end of input
+    inline int peek()
+    {
+        if (pos >= len && !refill())
+        {
+            return -1;
+        }
+        return (unsigned char)buffer[pos];
+    }
+
+    inline void advance()
+    {
+        pos++;
+    }
+
+    inline void skip_blanks()
+    {
+        int c = peek();
+        while (c == ' ' || c == '\t' || c == '\r')
+        {
+            advance();
+            c = peek();
+        }
+    }
+
+    // Skips past the end of the current line
+    void skip_line()
+    {
+        while (true)
+        {
+            if (pos >= len && !refill())
+            {
+                return;
+            }
+            // Scan the buffered chunk for a newline in one go
+            const char *newline = (const char *)memchr(buffer + pos, '\n', len - pos);
+            if (newline)
+            {
+                pos = newline - buffer + 1;
+                return;
+            }
+            pos = len;
+        }
+    }
+
+    // Positions at the first token of the next non comment / non blank line
+    bool next_data_line()
+    {
+        while (true)
+        {
+            skip_blanks();
+            int c = peek();
+            if (c == -1)
+            {
+                return false;
+            }
+            if (c == '#' || c == '\n')
+            {
+                skip_line();
+                continue;
+            }
+            return true;
+        }
+    }
+
+    // Reads an unsigned number on the current line, returns false if there is none
+    bool read_number(unsigned long &value)
+    {
+        skip_blanks();
+        int c = peek();
+        if (c < '0' || c > '9')
+        {
+            return false;
+        }
+        value = 0;
+        while (c >= '0' && c <= '9')
+        {
+            value = value * 10 + (c - '0');
+            advance();
+            c = peek();
+        }
+        return true;
+    }
+};
+
+// Writes the des_mmu text input format through one large buffer written with
+// write(), to a file or stdout ("-"). Mirrors TraceWriter for the binary format.
+class TextTraceWriter
+{
+public:
+    TextTraceWriter(const std::string &file_name, const std::vector<uint32_t> &vma_counts, const std::vector<trace_vma_spec> &vmas)
+    {
+        if (file_name == "-")
+        {
+            fd = STDOUT_FILENO;
+        }
+        else
+        {
+            fd = open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+            {
+                throw std::runtime_error("Could not open trace output file: " + file_name);
+            }
+            owns_fd = true;
+        }
+        buffer = new char[BUFFER_SIZE];
+
+        // Num processes, then per process its VMA count and VMA lines
+        put_number(vma_counts.size());
+        put_char('\n');
+        size_t vma = 0;
+        for (size_t i = 0; i < vma_counts.size(); i++)
+        {
+            put_number(vma_counts[i]);
+            put_char('\n');
+            for (uint32_t n = 0; n < vma_counts[i]; n++, vma++)
+            {
+                put_number(vmas[vma].start_vpage);
+                put_char(' ');
+                put_number(vmas[vma].end_vpage);
+                put_char(' ');
+                put_number(vmas[vma].write_protected);
+                put_char(' ');
+                put_number(vmas[vma].file_mapped);
+                put_char('\n');
+            }
+        }
+    }
+
+    ~TextTraceWriter()
+    {
+        finish();
+        delete[] buffer;
+    }
+
+    inline void add_record(char operation, uint64_t arg)
+    {
+        // Longest line: op, blank, 20 digits, newline
+        if (len + 24 > BUFFER_SIZE)
+        {
+            flush();
+        }
+        buffer[len++] = operation;
+        buffer[len++] = ' ';
+        put_number(arg);
+        buffer[len++] = '\n';
+    }
+
+    void finish()
+    {
+        if (fd < 0)
+        {
+            return;
+        }
+        flush();
+        if (owns_fd)
+        {
+            close(fd);
+        }
+        fd = -1;
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+    int fd = -1;
+    bool owns_fd = false;
+    char *buffer = nullptr;
+    size_t len = 0;
+
+    void flush()
+    {
+        size_t written = 0;
+        while (written < len)
+        {
+            ssize_t n = write(fd, buffer + written, len - written);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                throw std::runtime_error("Could not write trace output");
+            }
+            written += n;
+        }
+        len = 0;
+    }
+
+    inline void put_char(char c)
+    {
+        if (len == BUFFER_SIZE)
+        {
+            flush();
+        }
+        buffer[len++] = c;
+    }
+
+    // Digits are produced back to front, then copied in order
+    inline void put_number(uint64_t value)
+    {
+        char digits[20];
+        int n = 0;
+        do
+        {
+            digits[n++] = '0' + value % 10;
+            value /= 10;
+        } while (value);
+        if (len + n > BUFFER_SIZE)
+        {
+            flush();
+        }
+        while (n)
+        {
+            buffer[len++] = digits[--n];
+        }
+    }
+};
+
+#endif
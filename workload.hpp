@@ -0,0 +1,433 @@
+#include "data_structures.hpp"
+#include "trace_format.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef WORKLOAD
+#define WORKLOAD
+
+/* Synthetic des_mmu workloads with controlled locality. Every process gets
+   the same address space of pages tiled by num_vmas VMAs, each one file mapped
+   / write protected with the configured odds. Processes run in time slices of
+   quantum_min..quantum_max instructions, round robin or in random order, each
+   drawing its pages from the model of the current phase:
+   - uniform:  every page equally likely
+   - zipf:     page k (0 based) with probability ~ 1 / (k + 1)^theta
+   - scan:     0, 1, 2, ... wrapping around at the end of the address space
+   - stride:   0, s, 2s, ... then 1, 1 + s, ... (s lanes, strided loop)
+   - loop:     0 .. loop_pages - 1 over and over
+   The phases take turns every phase_length instructions, each turn shifts the
+   pages of the model by a new offset, so hot sets move across the address space.
+   With fork_after, process 0 runs alone for that many instructions and then
+   forks every other process, which start out sharing its pages copy-on-write.
+   After num_instructions reads / writes every process exits. */
+
+enum WORKLOAD_MODELS
+{
+    UNIFORM_WORKLOAD,
+    ZIPF_WORKLOAD,
+    SCAN_WORKLOAD,
+    STRIDE_WORKLOAD,
+    LOOP_WORKLOAD
+};
+
+const char *WORKLOAD_MODEL_NAMES[] = {"uniform", "zipf", "scan", "stride", "loop"};
+
+WORKLOAD_MODELS parse_workload_model(const std::string &name)
+{
+    for (int model = UNIFORM_WORKLOAD; model <= LOOP_WORKLOAD; model++)
+    {
+        if (name == WORKLOAD_MODEL_NAMES[model])
+        {
+            return (WORKLOAD_MODELS)model;
+        }
+    }
+    throw std::invalid_argument("Invalid workload model (uniform / zipf / scan / stride / loop): " + name);
+}
+
+typedef struct workload_phase
+{
+    WORKLOAD_MODELS model;
+    // zipf: theta, stride: stride in pages, loop: loop length in pages, unused otherwise
+    double param;
+} workload_phase;
+
+// Parses "model[:param],model[:param],...", i.e. "zipf:0.99,scan,loop:16"
+std::vector<workload_phase> parse_workload_phases(const std::string &spec)
+{
+    std::vector<workload_phase> phases;
+    size_t pos = 0;
+    while (pos <= spec.size())
+    {
+        size_t comma = spec.find(',', pos);
+        std::string item = spec.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        size_t colon = item.find(':');
+        workload_phase phase;
+        phase.model = parse_workload_model(item.substr(0, colon));
+        phase.param = phase.model == ZIPF_WORKLOAD ? 0.99 : phase.model == STRIDE_WORKLOAD ? 4 : 16;
+        if (colon != std::string::npos)
+        {
+            char *end;
+            phase.param = strtod(item.c_str() + colon + 1, &end);
+            if (*end != '\0' || phase.param <= 0)
+            {
+                throw std::invalid_argument("Invalid workload phase parameter: " + item);
+            }
+        }
+        phases.push_back(phase);
+        if (comma == std::string::npos)
+        {
+            break;
+        }
+        pos = comma + 1;
+    }
+    return phases;
+}
+
+typedef struct workload_config
+{
+    // Access models, taking turns every phase_length instructions (0 = first phase only)
+    std::vector<workload_phase> phases;
+    uint64_t phase_length;
+    unsigned int num_processes;
+    // Pages per process address space, at most NUM_PTE, and the VMAs tiling them
+    unsigned int pages;
+    unsigned int num_vmas;
+    // Odds of a VMA being file mapped / write protected
+    unsigned int file_percent;
+    unsigned int write_protect_percent;
+    // Share of accesses that are writes
+    unsigned int write_percent;
+    // Reads / writes per time slice, uniform in [quantum_min, quantum_max]
+    unsigned int quantum_min;
+    unsigned int quantum_max;
+    // Next process picked at random instead of round robin
+    bool random_order;
+    // Process 0 forks all others after this many instructions, 0 = no forks
+    uint64_t fork_after;
+    uint64_t num_instructions;
+    uint64_t seed;
+} workload_config;
+
+// One zipf phase over the full address space, 4 VMAs with one in four file mapped
+workload_config default_workload_config()
+{
+    workload_config config;
+    workload_phase zipf = {ZIPF_WORKLOAD, 0.99};
+    config.phases.push_back(zipf);
+    config.phase_length = 0;
+    config.num_processes = 4;
+    config.pages = NUM_PTE;
+    config.num_vmas = 4;
+    config.file_percent = 25;
+    config.write_protect_percent = 0;
+    config.write_percent = 30;
+    config.quantum_min = 100;
+    config.quantum_max = 100;
+    config.random_order = false;
+    config.fork_after = 0;
+    config.num_instructions = 1000000;
+    config.seed = 42;
+    return config;
+}
+
+// xorshift64*: fast, small state, good enough for address streams
+class WorkloadRng
+{
+public:
+    WorkloadRng(uint64_t seed)
+    {
+        // Zero is a fixed point of xorshift
+        state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+    }
+
+    inline uint64_t next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Uniform in [0, n)
+    inline uint64_t below(uint64_t n)
+    {
+        return next() % n;
+    }
+
+    // Uniform in [0, 1)
+    inline double unit()
+    {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t state;
+};
+
+/* Zipf sampler over 1..n by rejection inversion (Hormann & Derflinger),
+   O(1) memory and expected O(1) time per sample for any n and theta > 0 */
+class ZipfSampler
+{
+public:
+    ZipfSampler(uint64_t n_ = 1, double theta_ = 1.0)
+    {
+        n = n_;
+        theta = theta_;
+        h_integral_x1 = h_integral(1.5) - 1.0;
+        h_integral_n = h_integral(n + 0.5);
+        s = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+    }
+
+    uint64_t sample(WorkloadRng &rng) const
+    {
+        while (true)
+        {
+            double u = h_integral_n + rng.unit() * (h_integral_x1 - h_integral_n);
+            double x = h_integral_inverse(u);
+            uint64_t k = (uint64_t)(x + 0.5);
+            k = std::max((uint64_t)1, std::min(k, n));
+            if (k - x <= s || u >= h_integral(k + 0.5) - h(k))
+            {
+                return k;
+            }
+        }
+    }
+
+private:
+    uint64_t n;
+    double theta;
+    double h_integral_x1;
+    double h_integral_n;
+    double s;
+
+    double h(double x) const
+    {
+        return std::exp(-theta * std::log(x));
+    }
+
+    double h_integral(double x) const
+    {
+        double log_x = std::log(x);
+        return helper2((1.0 - theta) * log_x) * log_x;
+    }
+
+    double h_integral_inverse(double x) const
+    {
+        double t = std::max(-1.0, x * (1.0 - theta));
+        return std::exp(helper1(t) * x);
+    }
+
+    // log1p(x) / x, stable around 0
+    static double helper1(double x)
+    {
+        return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    // expm1(x) / x, stable around 0
+    static double helper2(double x)
+    {
+        return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+};
+
+// Pull style instruction stream of a synthetic workload
+class WorkloadGenerator
+{
+public:
+    WorkloadGenerator(const workload_config &config_) : rng(config_.seed)
+    {
+        config = config_;
+        if (config.num_processes == 0 || config.pages == 0 || config.pages > NUM_PTE || config.phases.empty())
+        {
+            throw std::invalid_argument("Invalid workload: needs processes, 1..NUM_PTE pages and a phase");
+        }
+        if (config.num_vmas == 0 || config.num_vmas > config.pages)
+        {
+            throw std::invalid_argument("Invalid workload: needs 1..pages VMAs");
+        }
+        if (config.quantum_min == 0 || config.quantum_max < config.quantum_min)
+        {
+            throw std::invalid_argument("Invalid workload: needs a quantum of min..max instructions, min > 0");
+        }
+        if (config.num_processes > 1u << PID_BITS)
+        {
+            throw std::invalid_argument("Invalid workload: more processes than PID_BITS allows");
+        }
+        for (size_t i = 0; i < config.phases.size(); i++)
+        {
+            workload_phase &phase = config.phases[i];
+            if (phase.model == STRIDE_WORKLOAD || phase.model == LOOP_WORKLOAD)
+            {
+                phase.param = std::max(1.0, std::min(std::floor(phase.param), (double)config.pages));
+            }
+        }
+        cursors.assign(config.num_processes, 0);
+        runnable = config.fork_after ? 1 : config.num_processes;
+        enter_phase(0);
+    }
+
+    // Process / VMA specs, as read from the header of a text input
+    unsigned int header(std::vector<uint32_t> &vma_counts, std::vector<trace_vma_spec> &vmas) const
+    {
+        // Flags come from their own stream, the layout doesn't shift the accesses
+        WorkloadRng layout_rng(config.seed ^ 0x5851F42D4C957F2DULL);
+        std::vector<trace_vma_spec> layout;
+        for (unsigned int i = 0; i < config.num_vmas; i++)
+        {
+            trace_vma_spec vma;
+            vma.start_vpage = (uint64_t)config.pages * i / config.num_vmas;
+            vma.end_vpage = (uint64_t)config.pages * (i + 1) / config.num_vmas - 1;
+            vma.write_protected = layout_rng.below(100) < config.write_protect_percent;
+            vma.file_mapped = layout_rng.below(100) < config.file_percent;
+            layout.push_back(vma);
+        }
+        for (unsigned int i = 0; i < config.num_processes; i++)
+        {
+            vmas.insert(vmas.end(), layout.begin(), layout.end());
+            vma_counts.push_back(config.num_vmas);
+        }
+        return config.num_processes;
+    }
+
+    // Next operation ('c', 'r', 'w', 'f' or 'e') + argument, false once every process exited
+    bool next(char &operation, int &arg)
+    {
+        if (pending_pos < pending_ops.size())
+        {
+            operation = pending_ops[pending_pos];
+            arg = pending_args[pending_pos++];
+            return true;
+        }
+        pending_ops.clear();
+        pending_args.clear();
+        pending_pos = 0;
+
+        if (emitted < config.num_instructions)
+        {
+            if (runnable < config.num_processes && emitted == config.fork_after)
+            {
+                // Process 0 is running, it forks every other process
+                for (unsigned int pid = 1; pid < config.num_processes; pid++)
+                {
+                    push_pending('f', pid);
+                }
+                runnable = config.num_processes;
+                slice = 0;
+                return next(operation, arg);
+            }
+            if (slice == 0)
+            {
+                // Time slice starts with a switch to the next process
+                slice = config.quantum_min;
+                if (config.quantum_max > config.quantum_min)
+                {
+                    slice += rng.below(config.quantum_max - config.quantum_min + 1);
+                }
+                current = config.random_order ? rng.below(runnable) : switches++ % runnable;
+                operation = 'c';
+                arg = current;
+                return true;
+            }
+            if (config.phase_length && emitted % config.phase_length == 0 && emitted)
+            {
+                enter_phase(emitted / config.phase_length);
+            }
+            slice--;
+            emitted++;
+            operation = rng.below(100) < config.write_percent ? 'w' : 'r';
+            arg = (int)((next_page(current) + offset) % config.pages);
+            return true;
+        }
+
+        // Exit every process, each one needs to be switched to first
+        if (exited)
+        {
+            return false;
+        }
+        for (unsigned int pid = 0; pid < config.num_processes; pid++)
+        {
+            push_pending('c', pid);
+            push_pending('e', pid);
+        }
+        exited = true;
+        return next(operation, arg);
+    }
+
+private:
+    workload_config config;
+    WorkloadRng rng;
+    ZipfSampler zipf;
+    workload_phase phase;
+    // Page shift of the current phase turn
+    uint64_t offset = 0;
+    std::vector<uint64_t> cursors;
+    uint64_t emitted = 0;
+    uint64_t switches = 0;
+    unsigned int slice = 0;
+    unsigned int current = 0;
+    // Processes 0 .. runnable - 1 exist (the rest wait to be forked)
+    unsigned int runnable;
+    bool exited = false;
+    std::vector<char> pending_ops;
+    std::vector<int> pending_args;
+    size_t pending_pos = 0;
+
+    void push_pending(char operation, int arg)
+    {
+        pending_ops.push_back(operation);
+        pending_args.push_back(arg);
+    }
+
+    // Turn n of the phase rotation: new model, new offset, cursors back to the start
+    void enter_phase(uint64_t turn)
+    {
+        phase = config.phases[turn % config.phases.size()];
+        if (phase.model == ZIPF_WORKLOAD)
+        {
+            zipf = ZipfSampler(config.pages, phase.param);
+        }
+        WorkloadRng turn_rng(config.seed + turn * 0x9E3779B97F4A7C15ULL);
+        offset = turn ? turn_rng.below(config.pages) : 0;
+        cursors.assign(config.num_processes, 0);
+    }
+
+    uint64_t next_page(unsigned int pid)
+    {
+        uint64_t &cursor = cursors[pid];
+        uint64_t page = cursor;
+        switch (phase.model)
+        {
+        case UNIFORM_WORKLOAD:
+            return rng.below(config.pages);
+        case ZIPF_WORKLOAD:
+            return zipf.sample(rng) - 1;
+        case SCAN_WORKLOAD:
+            cursor = cursor + 1 < config.pages ? cursor + 1 : 0;
+            break;
+        case STRIDE_WORKLOAD:
+        {
+            // Walk one lane, then start the next lane one page further
+            uint64_t stride = (uint64_t)phase.param;
+            cursor += stride;
+            if (cursor >= config.pages)
+            {
+                uint64_t lane = cursor % stride + 1;
+                cursor = lane < stride && lane < config.pages ? lane : 0;
+            }
+            break;
+        }
+        case LOOP_WORKLOAD:
+            cursor = cursor + 1 < (uint64_t)phase.param ? cursor + 1 : 0;
+            break;
+        }
+        return page;
+    }
+};
+
+#endif
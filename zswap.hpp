@@ -0,0 +1,214 @@
+#include "data_structures.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef ZSWAP
+#define ZSWAP
+
+// Compressed pages are sized in 1/ZSWAP_UNITS_PER_PAGE of a page (zsmalloc style size classes)
+const unsigned int ZSWAP_UNITS_PER_PAGE = 32;
+
+// Compressed swap tier, percent == 0 means off
+typedef struct zswap_config
+{
+    // Share of the -f frames given to the pool
+    unsigned int percent;
+    // Mean compression ratio of pages without an annotation
+    double ratio;
+} zswap_config;
+
+// Parses "percent[:ratio]"
+zswap_config parse_zswap_config(const std::string &spec)
+{
+    zswap_config config = {0, 3.0};
+    int n = sscanf(spec.c_str(), "%u:%lf", &config.percent, &config.ratio);
+    if (n < 1 || config.percent == 0 || config.percent > 99 || config.ratio < 1.0)
+    {
+        throw std::invalid_argument("Invalid compressed swap config (percent 1..99[:ratio >= 1]): " + spec);
+    }
+    return config;
+}
+
+// Frames of num_frames that go to the pool, the pager manages the rest
+unsigned int zswap_pool_frames(const zswap_config &config, unsigned int num_frames)
+{
+    return num_frames * config.percent / 100;
+}
+
+/* RAM pool of compressed anonymous pages in front of the swap disk.
+   Dirty anonymous victims are compressed into the pool instead of being
+   written out, pages that don't compress below a page are rejected and go to
+   disk as before. A full pool writes its least recently stored pages back to
+   disk to make room. Loads are exclusive: a faulted in page leaves the pool
+   and is dirty again, its next eviction stores it anew.
+
+   A page's compressed size comes from the last "z <percent>" annotation of
+   its process in effect when the page was written, otherwise it's synthetic:
+   a fixed per page value spread evenly over 0.5x..1.5x of the mean size
+   PAGE / ratio. */
+class CompressedPool
+{
+public:
+    CompressedPool(unsigned int pool_frames_, const zswap_config &config)
+    {
+        pool_frames = pool_frames_;
+        ratio = config.ratio;
+        capacity = pool_frames * ZSWAP_UNITS_PER_PAGE;
+        // Every entry takes at least one unit
+        lru.init(capacity);
+        index.init(capacity);
+        slot_keys.assign(capacity, 0);
+        slot_units.assign(capacity, 0);
+        for (int slot = capacity - 1; slot >= 0; slot--)
+        {
+            free_slots.push_back(slot);
+        }
+    }
+
+    unsigned int get_pool_frames() const
+    {
+        return pool_frames;
+    }
+
+    bool contains(unsigned int pid, int vpage) const
+    {
+        return index.find(page_key(pid, vpage)) >= 0;
+    }
+
+    // Compresses a page into the pool, false if it doesn't compress (rejected).
+    // Keys of the pages written back to disk to make room are appended to evicted.
+    bool store(unsigned int pid, int vpage, std::vector<uint64_t> &evicted)
+    {
+        uint64_t key = page_key(pid, vpage);
+        unsigned int units = compressed_units(key);
+        if (units >= ZSWAP_UNITS_PER_PAGE)
+        {
+            return false;
+        }
+        while (used + units > capacity)
+        {
+            int oldest = lru.front();
+            evicted.push_back(slot_keys[oldest]);
+            release(oldest);
+        }
+        int slot = free_slots.back();
+        free_slots.pop_back();
+        slot_keys[slot] = key;
+        slot_units[slot] = units;
+        index.insert(key, slot);
+        lru.push_back(slot);
+        used += units;
+        peak_used = std::max(peak_used, used);
+        return true;
+    }
+
+    // Decompresses a page out of the pool, false if it isn't there
+    bool load(unsigned int pid, int vpage)
+    {
+        int slot = index.find(page_key(pid, vpage));
+        if (slot < 0)
+        {
+            return false;
+        }
+        release(slot);
+        return true;
+    }
+
+    // Process exit: its pool entries are simply dropped
+    void drop_process(unsigned int pid)
+    {
+        int slot = lru.front();
+        while (slot != -1)
+        {
+            int next = lru.next_of(slot);
+            if ((unsigned int)(slot_keys[slot] >> 32) == pid)
+            {
+                release(slot);
+            }
+            slot = next;
+        }
+    }
+
+    // "z <percent>": data pid writes from now on compresses to percent of a page, 0 = synthetic
+    void set_data_compressibility(unsigned int pid, unsigned int percent)
+    {
+        if (pid >= data_percent.size())
+        {
+            data_percent.resize(pid + 1, 0);
+        }
+        data_percent[pid] = std::min(percent, 100u);
+    }
+
+    // A write stamps the process's current annotation onto the page
+    void page_written(unsigned int pid, int vpage)
+    {
+        unsigned int percent = pid < data_percent.size() ? data_percent[pid] : 0;
+        if (percent)
+        {
+            annotations[page_key(pid, vpage)] = percent;
+        }
+        else if (!annotations.empty())
+        {
+            annotations.erase(page_key(pid, vpage));
+        }
+    }
+
+    unsigned int entries() const
+    {
+        return lru.size();
+    }
+
+    // Pool occupancy in pages (compressed size), now and at peak
+    double used_pages() const
+    {
+        return (double)used / ZSWAP_UNITS_PER_PAGE;
+    }
+
+    double peak_pages() const
+    {
+        return (double)peak_used / ZSWAP_UNITS_PER_PAGE;
+    }
+
+private:
+    unsigned int pool_frames;
+    double ratio;
+    unsigned int capacity;
+    unsigned int used = 0;
+    unsigned int peak_used = 0;
+    // Entries live in slots, least recently stored at the front of lru
+    FrameList lru;
+    PageKeyMap index;
+    std::vector<uint64_t> slot_keys;
+    std::vector<uint8_t> slot_units;
+    std::vector<int> free_slots;
+    // Current "z" annotation per process, compressed percent per annotated page
+    std::vector<unsigned int> data_percent;
+    std::unordered_map<uint64_t, unsigned int> annotations;
+
+    unsigned int compressed_units(uint64_t key) const
+    {
+        std::unordered_map<uint64_t, unsigned int>::const_iterator annotated = annotations.find(key);
+        if (annotated != annotations.end())
+        {
+            return std::max(1u, (annotated->second * ZSWAP_UNITS_PER_PAGE + 99) / 100);
+        }
+        // Same mixing as PageKeyMap, the top 16 bits give an even spread over [0.5, 1.5)
+        double spread = 0.5 + (double)((key * 0x9E3779B97F4A7C15ULL) >> 48) / 65536.0;
+        unsigned int units = (unsigned int)(spread * ZSWAP_UNITS_PER_PAGE / ratio + 0.5);
+        return std::max(1u, std::min(units, ZSWAP_UNITS_PER_PAGE));
+    }
+
+    void release(int slot)
+    {
+        lru.remove(slot);
+        index.erase(slot_keys[slot]);
+        used -= slot_units[slot];
+        free_slots.push_back(slot);
+    }
+};
+
+#endif